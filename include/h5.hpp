@@ -27,20 +27,50 @@
 #define INCLUDED_SNSINFU_H5_HPP
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
 #include <initializer_list>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include <hdf5.h>
 
+#ifdef SNSINFU_H5_USE_ZLIB
+# include <zlib.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+# define SNSINFU_H5_HAS_MMAP
+# define SNSINFU_H5_HAS_FORK
+# include <fcntl.h>
+# include <poll.h>
+# include <signal.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
 
 namespace h5
 {
@@ -101,6 +131,28 @@ namespace h5
         private:
             std::unique_ptr<T> _value;
         };
+
+
+        // Returns the smallest prime number not less than `n`.
+        inline std::size_t next_prime(std::size_t n)
+        {
+            auto const is_prime = [](std::size_t k) {
+                if (k < 2) {
+                    return false;
+                }
+                for (std::size_t d = 2; d * d <= k; d++) {
+                    if (k % d == 0) {
+                        return false;
+                    }
+                }
+                return true;
+            };
+
+            while (!is_prime(n)) {
+                n++;
+            }
+            return n;
+        }
     }
 
 
@@ -476,6 +528,45 @@ namespace h5
                 shape.dims[i] = static_cast<std::size_t>(dims[i]);
             }
         }
+
+
+        // Compares shapes (or coordinates) in lexicographical order.
+        template<int rank>
+        bool shape_less(h5::shape<rank> const& s1, h5::shape<rank> const& s2)
+        {
+            return std::lexicographical_compare(
+                s1.dims, s1.dims + rank, s2.dims, s2.dims + rank
+            );
+        }
+
+
+        // Returns sorted unique values.
+        inline std::vector<std::size_t> sort_unique(std::vector<std::size_t> values)
+        {
+            std::sort(values.begin(), values.end());
+            values.erase(std::unique(values.begin(), values.end()), values.end());
+            return values;
+        }
+
+        template<int rank>
+        std::vector<h5::shape<rank>> sort_unique(std::vector<h5::shape<rank>> values)
+        {
+            std::sort(values.begin(), values.end(), detail::shape_less<rank>);
+            values.erase(std::unique(values.begin(), values.end()), values.end());
+            return values;
+        }
+
+
+        // Returns a shape with all dimensions set to one.
+        template<int rank>
+        h5::shape<rank> unit_shape()
+        {
+            h5::shape<rank> shape;
+            for (int i = 0; i < rank; i++) {
+                shape.dims[i] = 1;
+            }
+            return shape;
+        }
     }
 
 
@@ -556,12 +647,57 @@ namespace h5
 
     // AUTO CHUNKING ---------------------------------------------------------
 
+    // How a dataset is going to be accessed. Used to choose chunk shape.
+    enum class access_pattern
+    {
+        // No particular pattern.
+        any,
+
+        // Rows (sub-arrays along the first axis) are read one by one.
+        row_scan,
+
+        // Columns (sub-arrays along the last axes) are read one by one.
+        column_scan,
+
+        // Small rectangular regions are read at random.
+        random_tile,
+
+        // Records are appended along the first axis and read in order.
+        append,
+    };
+
+
+    // What `dataset::tune` optimizes for.
+    enum class tune_goal
+    {
+        // Smallest storage size.
+        size,
+
+        // Fastest read, including decompression.
+        read_speed,
+
+        // Product of storage size and read time.
+        balanced,
+    };
+
+
     namespace detail
     {
         // Computes a good chunk shape for the given dataset shape.
+        //
+        // The chunk is shrunk by halving axes until its size falls below a
+        // threshold. The order of the axes halved depends on `access`:
+        // row scans keep trailing axes whole, column scans keep leading axes
+        // whole, and random tile access keeps the chunk as square as
+        // possible.
+        //
         template<int rank>
         h5::shape<rank>
-        determine_chunk_size(h5::shape<rank> const& shape, std::size_t value_size)
+        determine_chunk_size(
+            h5::shape<rank> const& shape,
+            std::size_t value_size,
+            h5::access_pattern access = h5::access_pattern::any
+        )
         {
             // Heuristics from h5py/PyTables.
 
@@ -578,9 +714,41 @@ namespace h5
 
             auto chunk = shape;
 
-            for (int axis = 0; ; ++axis %= rank) {
+            // Chooses the next axis to halve.
+            auto next_axis = [&](int axis) {
+                switch (access) {
+                case h5::access_pattern::row_scan:
+                case h5::access_pattern::append:
+                    // Leading axis first.
+                    for (int i = 0; i < rank; i++) {
+                        if (chunk.dims[i] > 1) {
+                            return i;
+                        }
+                    }
+                    return 0;
+
+                case h5::access_pattern::column_scan:
+                    // Trailing axis first.
+                    for (int i = rank - 1; i >= 0; i--) {
+                        if (chunk.dims[i] > 1) {
+                            return i;
+                        }
+                    }
+                    return 0;
+
+                case h5::access_pattern::random_tile:
+                    // Longest axis first.
+                    return int(std::max_element(chunk.dims, chunk.dims + rank) - chunk.dims);
+
+                case h5::access_pattern::any:
+                    break;
+                }
+                return (axis + 1) % rank;
+            };
+
+            for (int axis = next_axis(-1); ; axis = next_axis(axis)) {
                 auto const chunk_size = chunk.size() * value_size;
-                if (chunk_size < threshold) {
+                if (chunk_size < threshold || chunk.size() <= 1) {
                     break;
                 }
 
@@ -594,674 +762,5572 @@ namespace h5
     }
 
 
-    // DATASET HANDLING ------------------------------------------------------
+    // OBJECT LISTING --------------------------------------------------------
 
-    // Optional parameters passed to `dataset::write`.
-    struct dataset_options
+    // Type of an object in a file.
+    enum class object_type
     {
-        // Enables deflate compression when set. The value designates the
-        // compression level: 0 for none, 1 for the fastest, 9 for the best.
-        //
-        // The minimum, fastest compression level 1 tends to be enough when
-        // `scaleoffset` is set to a proper value.
-        //
-        detail::optional<int> compression;
+        group,
+        dataset,
 
-        // Enables "scale-offset" lossy compression when set.
-        //
-        // This option is effective only for integral and floating-point
-        // dataset. For integral dataset, the value designates the number of
-        // retained bits. For floating-point dataset, the value designates the
-        // base-10 exponent of the scaling factor.
-        //
-        detail::optional<int> scaleoffset;
+        // Named (committed) datatype.
+        datatype,
+
+        // Soft or external link, or unknown object.
+        other,
+    };
+
+
+    // Class of dataset values.
+    enum class type_class
+    {
+        integer,
+        floating_point,
+        string,
+        enumeration,
+        compound,
+        other,
+    };
+
+
+    // Description of an object returned by `file::list` and `file::info`.
+    struct object_info
+    {
+        // Path of the object relative to the listed group.
+        std::string path;
+
+        // Type of the object.
+        h5::object_type type = h5::object_type::other;
+
+        // Rank, shape and value type of a dataset. Set only for datasets,
+        // and only if `list_options::dataset_info` is true when listed.
+        int rank = 0;
+        std::vector<std::size_t> shape;
+        h5::type_class value_class = h5::type_class::other;
+        std::size_t value_size = 0;
+
+        // Bytes the dataset occupies in the file. Set along with the shape.
+        std::size_t storage_size = 0;
+    };
+
+
+    // Optional parameters passed to `file::list`.
+    struct list_options
+    {
+        // Lists all objects under the group rather than its direct children.
+        bool recursive = false;
+
+        // Opens each dataset to retrieve its rank, shape and value type.
+        // Listing is much faster without this as only links are read. Use
+        // `file::info` to retrieve them later for individual datasets.
+        bool dataset_info = true;
     };
 
 
     namespace detail
     {
-        // Checks the rank of a dataset. Throws an exception if the actual rank
-        // is not the expected `rank`. Otherwise, returns the shape.
-        template<int rank>
-        h5::shape<rank> check_dataset_rank(hid_t dataset)
+#if H5_VERSION_GE(1, 12, 0)
+        using link_info = H5L_info2_t;
+#else
+        using link_info = H5L_info_t;
+#endif
+
+
+        // Returns the type of the object at `name` relative to `loc`.
+        inline h5::object_type get_object_type(hid_t loc, char const* name)
         {
-            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
-            if (dataspace < 0) {
-                throw h5::exception("failed to determine dataspace");
+#if H5_VERSION_GE(1, 12, 0)
+            H5O_info2_t info;
+            auto const status = H5Oget_info_by_name3(loc, name, &info, H5O_INFO_BASIC, H5P_DEFAULT);
+#elif H5_VERSION_GE(1, 10, 3)
+            H5O_info_t info;
+            auto const status = H5Oget_info_by_name2(loc, name, &info, H5O_INFO_BASIC, H5P_DEFAULT);
+#else
+            H5O_info_t info;
+            auto const status = H5Oget_info_by_name(loc, name, &info, H5P_DEFAULT);
+#endif
+            if (status < 0) {
+                throw h5::exception("failed to get object info");
             }
 
-            auto const dataset_rank = H5Sget_simple_extent_ndims(dataspace);
-            if (dataset_rank != rank) {
-                throw h5::exception("unexpected dataset rank");
+            switch (info.type) {
+            case H5O_TYPE_GROUP:
+                return h5::object_type::group;
+            case H5O_TYPE_DATASET:
+                return h5::object_type::dataset;
+            case H5O_TYPE_NAMED_DATATYPE:
+                return h5::object_type::datatype;
+            default:
+                return h5::object_type::other;
             }
+        }
 
-            hsize_t dims[rank];
-            if (H5Sget_simple_extent_dims(dataspace, dims, nullptr) < 0) {
-                throw h5::exception("failed to determine dataset shape");
+
+#if H5_VERSION_GE(1, 12, 0)
+        using object_address = H5O_token_t;
+#else
+        using object_address = haddr_t;
+#endif
+
+
+        // Returns the address of the object at `name` relative to `loc`,
+        // which identifies the object in the file.
+        inline detail::object_address get_object_address(hid_t loc, char const* name)
+        {
+#if H5_VERSION_GE(1, 12, 0)
+            H5O_info2_t info;
+            auto const status = H5Oget_info_by_name3(loc, name, &info, H5O_INFO_BASIC, H5P_DEFAULT);
+#elif H5_VERSION_GE(1, 10, 3)
+            H5O_info_t info;
+            auto const status = H5Oget_info_by_name2(loc, name, &info, H5O_INFO_BASIC, H5P_DEFAULT);
+#else
+            H5O_info_t info;
+            auto const status = H5Oget_info_by_name(loc, name, &info, H5P_DEFAULT);
+#endif
+            if (status < 0) {
+                throw h5::exception("failed to get object info");
             }
 
-            h5::shape<rank> shape;
-            detail::set_dims(dims, shape);
-            return shape;
+#if H5_VERSION_GE(1, 12, 0)
+            return info.token;
+#else
+            return info.addr;
+#endif
         }
 
-        template<>
-        inline h5::shape<0> check_dataset_rank<0>(hid_t dataset)
+
+        // Returns the number of hard links to an open object. An object
+        // unlinked while open has no link and is deleted when closed.
+        inline unsigned get_link_count(hid_t object)
         {
-            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
-            if (dataspace < 0) {
-                throw h5::exception("failed to determine dataspace");
+#if H5_VERSION_GE(1, 12, 0)
+            H5O_info2_t info;
+            auto const status = H5Oget_info3(object, &info, H5O_INFO_BASIC);
+#elif H5_VERSION_GE(1, 10, 3)
+            H5O_info_t info;
+            auto const status = H5Oget_info2(object, &info, H5O_INFO_BASIC);
+#else
+            H5O_info_t info;
+            auto const status = H5Oget_info(object, &info);
+#endif
+            if (status < 0) {
+                throw h5::exception("failed to get object info");
             }
+            return info.rc;
+        }
 
-            auto const dataset_rank = H5Sget_simple_extent_ndims(dataspace);
-            if (dataset_rank != 0) {
-                throw h5::exception("unexpected dataset rank");
+
+        // Retrieves the address of the object hard-linked at `path` without
+        // reading the object header. Returns false if `path` does not exist
+        // or is not a hard link.
+        inline bool get_link_address(hid_t file, char const* path, detail::object_address& address)
+        {
+            detail::link_info link;
+            herr_t status = -1;
+
+            H5E_BEGIN_TRY {
+#if H5_VERSION_GE(1, 12, 0)
+                status = H5Lget_info2(file, path, &link, H5P_DEFAULT);
+#else
+                status = H5Lget_info(file, path, &link, H5P_DEFAULT);
+#endif
+            } H5E_END_TRY;
+
+            if (status < 0 || link.type != H5L_TYPE_HARD) {
+                return false;
             }
 
-            return {};
+#if H5_VERSION_GE(1, 12, 0)
+            address = link.u.token;
+#else
+            address = link.u.address;
+#endif
+            return true;
         }
 
 
-        // Checks if the datatype of `dataset` is compatible with `D`. Throws
-        // an exception if the types are incompatible. Returns a datatype hid
-        // of the dataset on success.
-        template<typename D>
-        h5::unique_hid<H5Tclose> check_dataset_type(hid_t dataset)
+        // Returns true if two object addresses in the file `loc` are equal.
+        inline bool same_object_address(
+            hid_t loc, detail::object_address const& addr1, detail::object_address const& addr2
+        )
+        {
+#if H5_VERSION_GE(1, 12, 0)
+            int order;
+            if (H5Otoken_cmp(loc, &addr1, &addr2, &order) < 0) {
+                throw h5::exception("failed to compare objects");
+            }
+            return order == 0;
+#else
+            (void) loc;
+            return addr1 == addr2;
+#endif
+        }
+
+
+        // Fills the rank, shape and value type of the dataset at `name`.
+        inline void get_dataset_info(hid_t loc, char const* name, h5::object_info& info)
         {
+            h5::unique_hid<H5Dclose> dataset = H5Dopen2(loc, name, H5P_DEFAULT);
+            if (dataset < 0) {
+                throw h5::exception("failed to open dataset");
+            }
+
+            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
+            if (dataspace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+
+            hsize_t dims[H5S_MAX_RANK];
+            auto const rank = H5Sget_simple_extent_dims(dataspace, dims, nullptr);
+            if (rank < 0) {
+                throw h5::exception("failed to determine dataset shape");
+            }
+            info.rank = rank;
+            info.shape.assign(dims, dims + rank);
+
             h5::unique_hid<H5Tclose> datatype = H5Dget_type(dataset);
             if (datatype < 0) {
                 throw h5::exception("failed to determine datatype");
             }
+            info.value_size = H5Tget_size(datatype);
+            info.storage_size = static_cast<std::size_t>(H5Dget_storage_size(dataset));
+
+            switch (H5Tget_class(datatype)) {
+            case H5T_INTEGER:
+                info.value_class = h5::type_class::integer;
+                break;
+            case H5T_FLOAT:
+                info.value_class = h5::type_class::floating_point;
+                break;
+            case H5T_STRING:
+                info.value_class = h5::type_class::string;
+                break;
+            case H5T_ENUM:
+                info.value_class = h5::type_class::enumeration;
+                break;
+            case H5T_COMPOUND:
+                info.value_class = h5::type_class::compound;
+                break;
+            default:
+                info.value_class = h5::type_class::other;
+                break;
+            }
+        }
 
-            H5T_cdata_t* cdata = nullptr;
-            if (H5Tfind(datatype, h5::storage_type<D>(), &cdata) == nullptr) {
-                throw h5::exception("incompatible dataset type");
+
+        // Describes the object linked at `name` relative to `loc`.
+        inline h5::object_info describe_object(
+            hid_t loc, char const* name, H5L_type_t link_type, bool dataset_info
+        )
+        {
+            h5::object_info info;
+            info.path = name;
+
+            if (link_type != H5L_TYPE_HARD) {
+                return info;
             }
 
-            return datatype;
+            info.type = detail::get_object_type(loc, name);
+
+            if (info.type == h5::object_type::dataset && dataset_info) {
+                detail::get_dataset_info(loc, name, info);
+            }
+            return info;
         }
 
 
-        // Checks if the datatype of `dataset` is an enum that matches given
-        // definition. Throws an `h5::exception` if not.
-        template<typename D>
-        void check_dataset_enums(hid_t dataset, h5::enums<D> const& enums)
+        // Returns the path of the dataset storing the catalog of a file.
+        // The path is reserved and hidden from listings.
+        inline char const* catalog_path()
         {
-            h5::unique_hid<H5Tclose> datatype = H5Dget_type(dataset);
-            if (datatype < 0) {
-                throw h5::exception("failed to determine enum datatype");
+            return ".catalog";
+        }
+
+
+        // Returns true if `path` is the path of the catalog.
+        inline bool is_catalog_path(std::string const& path)
+        {
+            auto const start = path.find_first_not_of('/');
+            if (start == std::string::npos) {
+                return false;
             }
+            return path.compare(start, std::string::npos, detail::catalog_path()) == 0;
+        }
 
-            detail::check_enum_type(datatype, enums);
+
+        // Returns the address of the object a hard link points to.
+        inline detail::object_address get_link_target(detail::link_info const& link)
+        {
+#if H5_VERSION_GE(1, 12, 0)
+            return link.u.token;
+#else
+            return link.u.address;
+#endif
         }
 
 
-        template<typename D>
-        H5Z_SO_scale_type_t determine_scaleoffset_type()
+        // Returns the bytes of an object address as a hashable key.
+        inline std::string address_key(detail::object_address const& address)
         {
-            if (std::is_floating_point<D>::value) {
-                return H5Z_SO_FLOAT_DSCALE;
-            }
-            if (std::is_integral<D>::value) {
-                return H5Z_SO_INT;
-            }
-            throw h5::exception("cannot apply scaleoffset to specified datatype");
+            return std::string(reinterpret_cast<char const*>(&address), sizeof address);
         }
 
 
-        // Creates a new simple dataset.
-        template<typename D, int rank>
-        h5::unique_hid<H5Dclose> create_simple_dataset(
-            hid_t file,
-            std::string const& path,
-            hid_t datatype,
-            h5::shape<rank> const& shape,
-            h5::dataset_options const& options
-        )
+        using object_visitor = std::function<void(h5::object_info&&)>;
+
+
+        // State of a link iteration.
+        struct list_context
         {
-            hsize_t dims[rank];
-            detail::set_dims(shape, dims);
+            std::string prefix;
+            h5::list_options const& options;
+            bool hide_catalog;
+            std::unordered_set<std::string>& visited_groups;
+            detail::object_visitor const& visitor;
+            std::exception_ptr error;
+        };
 
-            h5::unique_hid<H5Sclose> dataspace = H5Screate_simple(rank, dims, nullptr);
-            if (dataspace < 0) {
-                throw h5::exception("failed to create dataspace");
-            }
 
-            // Allow intermediate groups to be automatically created.
-            h5::unique_hid<H5Pclose> link_props = H5Pcreate(H5P_LINK_CREATE);
-            if (link_props < 0) {
-                throw h5::exception("failed to create link props");
+        inline void visit_group(
+            hid_t group,
+            std::string const& prefix,
+            h5::list_options const& options,
+            bool hide_catalog,
+            std::unordered_set<std::string>& visited_groups,
+            detail::object_visitor const& visitor
+        );
+
+
+        inline herr_t list_callback(
+            hid_t group, char const* name, detail::link_info const* link, void* data
+        )
+        {
+            auto& context = *static_cast<detail::list_context*>(data);
+            if (context.hide_catalog && std::strcmp(name, detail::catalog_path()) == 0) {
+                return 0;
             }
-            if (H5Pset_create_intermediate_group(link_props, 1) < 0) {
-                throw h5::exception("failed to configure link props");
+            try {
+                auto info = detail::describe_object(
+                    group, name, link->type, context.options.dataset_info
+                );
+                info.path.insert(0, context.prefix);
+
+                // Descend into each group once, even if hard links form a
+                // cycle or link a group from several places.
+                auto const descend =
+                    context.options.recursive &&
+                    info.type == h5::object_type::group &&
+                    context.visited_groups.insert(
+                        detail::address_key(detail::get_link_target(*link))
+                    ).second;
+                auto const subgroup_prefix = info.path + '/';
+
+                context.visitor(std::move(info));
+
+                if (descend) {
+                    h5::unique_hid<H5Gclose> subgroup = H5Gopen2(group, name, H5P_DEFAULT);
+                    if (subgroup < 0) {
+                        throw h5::exception("failed to open group");
+                    }
+                    detail::visit_group(
+                        subgroup,
+                        subgroup_prefix,
+                        context.options,
+                        false,
+                        context.visited_groups,
+                        context.visitor
+                    );
+                }
+            } catch (...) {
+                context.error = std::current_exception();
+                return -1;
             }
+            return 0;
+        }
 
-            // Optional filters.
-            h5::unique_hid<H5Pclose> dataset_props = H5Pcreate(H5P_DATASET_CREATE);
-            if (dataset_props < 0) {
-                throw h5::exception("failed to create dataset props");
-            }
 
-            if (options.compression || options.scaleoffset) {
-                auto const chunk = detail::determine_chunk_size(shape, sizeof(D));
+        // Passes objects in `group` to `visitor` as the links are read,
+        // followed by the contents of each subgroup if listing recursively.
+        // Each group is iterated in its own creation order if it tracks it,
+        // or in the name order.
+        inline void visit_group(
+            hid_t group,
+            std::string const& prefix,
+            h5::list_options const& options,
+            bool hide_catalog,
+            std::unordered_set<std::string>& visited_groups,
+            detail::object_visitor const& visitor
+        )
+        {
+            h5::unique_hid<H5Pclose> group_props = H5Gget_create_plist(group);
+            if (group_props < 0) {
+                throw h5::exception("failed to get group props");
+            }
 
-                hsize_t chunk_dims[rank];
-                set_dims(chunk, chunk_dims);
-                if (H5Pset_chunk(dataset_props, rank, chunk_dims) < 0) {
-                    throw h5::exception("failed to set chunk size");
-                }
+            unsigned order_flags = 0;
+            if (H5Pget_link_creation_order(group_props, &order_flags) < 0) {
+                throw h5::exception("failed to get link creation order");
             }
 
-            if (options.scaleoffset) {
-                auto const type = detail::determine_scaleoffset_type<D>();
-                auto const factor = *options.scaleoffset;
+            auto const index =
+                (order_flags & H5P_CRT_ORDER_INDEXED) ? H5_INDEX_CRT_ORDER : H5_INDEX_NAME;
 
-                if (H5Pset_scaleoffset(dataset_props, type, factor) < 0) {
-                    throw h5::exception("failed to set shuffle filter");
+            detail::list_context context{
+                prefix, options, hide_catalog, visited_groups, visitor, nullptr
+            };
+#if H5_VERSION_GE(1, 12, 0)
+            auto const status = H5Literate2(
+                group, index, H5_ITER_INC, nullptr, detail::list_callback, &context
+            );
+#else
+            auto const status = H5Literate(
+                group, index, H5_ITER_INC, nullptr, detail::list_callback, &context
+            );
+#endif
+            if (status < 0) {
+                if (context.error) {
+                    std::rethrow_exception(context.error);
                 }
+                throw h5::exception("failed to iterate over links");
             }
+        }
 
-            if (options.compression) {
-                auto const level = static_cast<unsigned>(*options.compression);
 
-                if (H5Pset_shuffle(dataset_props) < 0) {
-                    throw h5::exception("failed to set shuffle filter");
-                }
-                if (H5Pset_deflate(dataset_props, level) < 0) {
-                    throw h5::exception("failed to set deflate filter");
-                }
+        // Passes objects in the group at `path` to `visitor` one by one. See
+        // `visit_group`.
+        inline void visit_objects(
+            hid_t file,
+            std::string const& path,
+            h5::list_options const& options,
+            detail::object_visitor const& visitor
+        )
+        {
+            h5::unique_hid<H5Gclose> group = H5Gopen2(file, path.c_str(), H5P_DEFAULT);
+            if (group < 0) {
+                throw h5::exception("failed to open group");
             }
 
-            h5::unique_hid<H5Dclose> dataset = H5Dcreate2(
-                file,
-                path.c_str(),
-                datatype,
-                dataspace,
-                link_props,
-                dataset_props,
-                H5P_DEFAULT
+            std::unordered_set<std::string> visited_groups;
+            visited_groups.insert(
+                detail::address_key(detail::get_object_address(group, "."))
             );
-            if (dataset < 0) {
-                throw h5::exception("failed to create dataset");
-            }
 
-            return dataset;
+            // Names are relative to the listed group, so the catalog appears
+            // as is only when the root group is listed.
+            bool const hide_catalog = path.find_first_not_of('/') == std::string::npos;
+
+            detail::visit_group(group, "", options, hide_catalog, visited_groups, visitor);
         }
 
 
-        // Creates a new simple dataset with unlimited first dimension.
-        template<typename D, int record_rank>
-        h5::unique_hid<H5Dclose> create_unlimited_dataset(
-            hid_t file,
-            std::string const& path,
-            hid_t datatype,
-            h5::shape<record_rank> const& record_shape,
-            h5::dataset_options const& options
+        // Lists objects in the group at `path`. See `visit_group`.
+        inline std::vector<h5::object_info> list_group(
+            hid_t file, std::string const& path, h5::list_options const& options
         )
         {
-            static constexpr int data_rank = record_rank + 1;
+            std::vector<h5::object_info> objects;
+            detail::visit_objects(file, path, options, [&](h5::object_info&& info) {
+                objects.push_back(std::move(info));
+            });
+            return objects;
+        }
+    }
 
-            hsize_t dims[data_rank];
-            dims[0] = 0;
-            detail::set_dims(record_shape, dims + 1);
 
-            hsize_t max_dims[data_rank];
-            max_dims[0] = H5S_UNLIMITED;
-            detail::set_dims(record_shape, max_dims + 1);
+    // CATALOG ---------------------------------------------------------------
 
-            h5::unique_hid<H5Sclose> dataspace = H5Screate_simple(data_rank, dims, max_dims);
-            if (dataspace < 0) {
-                throw h5::exception("failed to create dataspace");
+    namespace detail
+    {
+        // Layout of a catalog record. Shapes and paths are stored in fixed
+        // size fields sized to the largest entry, so the whole catalog is
+        // read at once without variable-length data.
+        struct catalog_layout
+        {
+            std::size_t max_rank = 1;
+            std::size_t path_size = 1;
+
+            static constexpr std::size_t shape_offset = 24;
+
+            std::size_t path_offset() const
+            {
+                return shape_offset + sizeof(std::uint64_t) * max_rank;
             }
 
-            // Allow intermediate groups to be automatically created.
-            h5::unique_hid<H5Pclose> link_props = H5Pcreate(H5P_LINK_CREATE);
-            if (link_props < 0) {
-                throw h5::exception("failed to create link props");
+            std::size_t record_size() const
+            {
+                return path_offset() + path_size;
             }
-            if (H5Pset_create_intermediate_group(link_props, 1) < 0) {
-                throw h5::exception("failed to configure link props");
+        };
+
+
+        // Creates the compound datatype of catalog records. Integers are
+        // little-endian in the `storage` type and native in the other.
+        inline h5::unique_hid<H5Tclose> make_catalog_type(
+            detail::catalog_layout const& layout, bool storage
+        )
+        {
+            hid_t const u64_type = storage ? H5T_STD_U64LE : H5T_NATIVE_UINT64;
+            hid_t const i32_type = storage ? H5T_STD_I32LE : H5T_NATIVE_INT32;
+
+            hsize_t const shape_dims[] = {layout.max_rank};
+            h5::unique_hid<H5Tclose> shape_type = H5Tarray_create2(u64_type, 1, shape_dims);
+            if (shape_type < 0) {
+                throw h5::exception("failed to create catalog shape type");
             }
 
-            // Optional filters.
-            h5::unique_hid<H5Pclose> dataset_props = H5Pcreate(H5P_DATASET_CREATE);
-            if (dataset_props < 0) {
-                throw h5::exception("failed to create dataset props");
+            h5::unique_hid<H5Tclose> path_type = H5Tcopy(H5T_C_S1);
+            if (path_type < 0) {
+                throw h5::exception("failed to create catalog path type");
+            }
+            if (H5Tset_size(path_type, layout.path_size) < 0) {
+                throw h5::exception("failed to set catalog path size");
             }
 
-            // Unlimited dataset is always chunked. We first chunk record. If
-            // a whole record may fit in a chunk, we extend the chunk so that
-            // multiple records are stored in a chunk.
-            constexpr std::size_t KiB = 1024;
-            constexpr std::size_t base_size = 24 * KiB; // Arbitrary
+            h5::unique_hid<H5Tclose> type = H5Tcreate(H5T_COMPOUND, layout.record_size());
+            if (type < 0) {
+                throw h5::exception("failed to create catalog type");
+            }
+
+            bool const ok =
+                H5Tinsert(type, "value_size", 0, u64_type) >= 0 &&
+                H5Tinsert(type, "storage_size", 8, u64_type) >= 0 &&
+                H5Tinsert(type, "value_class", 16, i32_type) >= 0 &&
+                H5Tinsert(type, "rank", 20, i32_type) >= 0 &&
+                H5Tinsert(type, "shape", layout.shape_offset, shape_type) >= 0 &&
+                H5Tinsert(type, "path", layout.path_offset(), path_type) >= 0;
+            if (!ok) {
+                throw h5::exception("failed to define catalog type");
+            }
 
-            auto const record_chunk = detail::determine_chunk_size(record_shape, sizeof(D));
-            auto const stream_chunk = 1 + base_size / (record_chunk.size() * sizeof(D));
+            return type;
+        }
 
-            hsize_t chunk_dims[data_rank];
-            chunk_dims[0] = static_cast<hsize_t>(stream_chunk);
-            set_dims(record_chunk, chunk_dims + 1);
 
-            if (H5Pset_chunk(dataset_props, data_rank, chunk_dims) < 0) {
-                throw h5::exception("failed to set chunk size");
+        // Determines the layout of the catalog records stored in a file.
+        inline detail::catalog_layout get_catalog_layout(hid_t datatype)
+        {
+            detail::catalog_layout layout;
+
+            auto const shape_index = H5Tget_member_index(datatype, "shape");
+            auto const path_index = H5Tget_member_index(datatype, "path");
+            if (shape_index < 0 || path_index < 0) {
+                throw h5::exception("unrecognized catalog format");
             }
 
-            if (options.scaleoffset) {
-                auto const type = detail::determine_scaleoffset_type<D>();
-                auto const factor = *options.scaleoffset;
+            h5::unique_hid<H5Tclose> shape_type = H5Tget_member_type(datatype, unsigned(shape_index));
+            h5::unique_hid<H5Tclose> path_type = H5Tget_member_type(datatype, unsigned(path_index));
+            if (shape_type < 0 || path_type < 0) {
+                throw h5::exception("failed to get catalog member type");
+            }
 
-                if (H5Pset_scaleoffset(dataset_props, type, factor) < 0) {
-                    throw h5::exception("failed to set shuffle filter");
+            hsize_t shape_dims[1];
+            if (H5Tget_array_ndims(shape_type) != 1 || H5Tget_array_dims2(shape_type, shape_dims) < 0) {
+                throw h5::exception("unrecognized catalog format");
+            }
+            layout.max_rank = static_cast<std::size_t>(shape_dims[0]);
+            layout.path_size = H5Tget_size(path_type);
+
+            return layout;
+        }
+
+
+        // Reads the catalog stored in a file with a single read.
+        inline std::vector<h5::object_info> load_catalog(hid_t file)
+        {
+            h5::unique_hid<H5Dclose> dataset = H5Dopen2(file, detail::catalog_path(), H5P_DEFAULT);
+            if (dataset < 0) {
+                throw h5::exception("failed to open catalog");
+            }
+
+            h5::unique_hid<H5Tclose> file_type = H5Dget_type(dataset);
+            if (file_type < 0) {
+                throw h5::exception("failed to determine catalog type");
+            }
+            auto const layout = detail::get_catalog_layout(file_type);
+            auto const mem_type = detail::make_catalog_type(layout, false);
+
+            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
+            if (dataspace < 0) {
+                throw h5::exception("failed to determine catalog size");
+            }
+            auto const count = static_cast<std::size_t>(H5Sget_simple_extent_npoints(dataspace));
+
+            std::vector<unsigned char> records(count * layout.record_size());
+            if (count > 0) {
+                if (H5Dread(dataset, mem_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, records.data()) < 0) {
+                    throw h5::exception("failed to read catalog");
                 }
             }
 
-            if (options.compression) {
-                auto const level = static_cast<unsigned>(*options.compression);
+            std::vector<h5::object_info> entries(count);
 
-                if (H5Pset_shuffle(dataset_props) < 0) {
-                    throw h5::exception("failed to set shuffle filter");
+            for (std::size_t i = 0; i < count; i++) {
+                auto const record = records.data() + i * layout.record_size();
+                auto& entry = entries[i];
+
+                std::uint64_t value_size;
+                std::uint64_t storage_size;
+                std::int32_t value_class;
+                std::int32_t rank;
+                std::memcpy(&value_size, record, sizeof value_size);
+                std::memcpy(&storage_size, record + 8, sizeof storage_size);
+                std::memcpy(&value_class, record + 16, sizeof value_class);
+                std::memcpy(&rank, record + 20, sizeof rank);
+
+                if (rank < 0 || std::size_t(rank) > layout.max_rank) {
+                    throw h5::exception("corrupted catalog record");
                 }
-                if (H5Pset_deflate(dataset_props, level) < 0) {
-                    throw h5::exception("failed to set deflate filter");
+
+                entry.type = h5::object_type::dataset;
+                entry.value_size = static_cast<std::size_t>(value_size);
+                entry.storage_size = static_cast<std::size_t>(storage_size);
+                entry.value_class = static_cast<h5::type_class>(value_class);
+                entry.rank = rank;
+                entry.shape.resize(std::size_t(rank));
+
+                for (std::size_t j = 0; j < entry.shape.size(); j++) {
+                    std::uint64_t dim;
+                    std::memcpy(&dim, record + layout.shape_offset + j * sizeof dim, sizeof dim);
+                    entry.shape[j] = static_cast<std::size_t>(dim);
                 }
-            }
 
-            h5::unique_hid<H5Dclose> dataset = H5Dcreate2(
-                file,
-                path.c_str(),
-                datatype,
-                dataspace,
-                link_props,
-                dataset_props,
-                H5P_DEFAULT
-            );
-            if (dataset < 0) {
-                throw h5::exception("failed to create unlimited dataset");
+                auto const path = reinterpret_cast<char const*>(record + layout.path_offset());
+                entry.path.assign(path, std::find(path, path + layout.path_size, '\0'));
             }
 
-            return dataset;
+            return entries;
         }
 
-        // Creates a new scalar dataset.
-        template<typename D>
-        h5::unique_hid<H5Dclose> create_scalar_dataset(
-            hid_t file, std::string const& path, hid_t datatype
-        )
+
+        // Returns the name of the attribute flagging the stored catalog as
+        // up to date.
+        inline char const* catalog_valid_name()
         {
-            h5::unique_hid<H5Sclose> dataspace = H5Screate(H5S_SCALAR);
-            if (dataspace < 0) {
-                throw h5::exception("failed to create dataspace");
+            return "valid";
+        }
+
+
+        // Returns true if the file has a stored catalog that is up to date.
+        inline bool check_catalog_valid(hid_t file)
+        {
+            auto const exists = H5Lexists(file, detail::catalog_path(), H5P_DEFAULT);
+            if (exists < 0) {
+                throw h5::exception("failed to check catalog");
+            }
+            if (exists == 0) {
+                return false;
             }
 
-            // Allow intermediate groups to be automatically created.
-            h5::unique_hid<H5Pclose> link_props = H5Pcreate(H5P_LINK_CREATE);
-            if (link_props < 0) {
-                throw h5::exception("failed to create link props");
+            auto const valid_exists = H5Aexists_by_name(
+                file, detail::catalog_path(), detail::catalog_valid_name(), H5P_DEFAULT
+            );
+            if (valid_exists < 0) {
+                throw h5::exception("failed to check catalog");
             }
-            if (H5Pset_create_intermediate_group(link_props, 1) < 0) {
-                throw h5::exception("failed to configure link props");
+            if (valid_exists == 0) {
+                return false;
             }
 
-            h5::unique_hid<H5Dclose> dataset = H5Dcreate2(
-                file,
-                path.c_str(),
-                datatype,
-                dataspace,
-                link_props,
-                H5P_DEFAULT,
-                H5P_DEFAULT
+            h5::unique_hid<H5Aclose> attribute = H5Aopen_by_name(
+                file, detail::catalog_path(), detail::catalog_valid_name(), H5P_DEFAULT, H5P_DEFAULT
             );
-            if (dataset < 0) {
-                throw h5::exception("failed to create dataset");
+            if (attribute < 0) {
+                throw h5::exception("failed to open catalog attribute");
             }
 
-            return dataset;
+            std::uint8_t valid = 0;
+            if (H5Aread(attribute, H5T_NATIVE_UINT8, &valid) < 0) {
+                throw h5::exception("failed to read catalog attribute");
+            }
+            return valid != 0;
         }
 
 
-        // Reads dataset into given buffer.
-        template<typename T>
-        void read_dataset(hid_t dataset, T* buf, std::size_t)
+        // Flags a catalog dataset as up to date or stale. The flag is
+        // rewritten in place, so marking the catalog stale costs no space.
+        inline void write_catalog_valid(hid_t dataset, bool valid)
         {
-            auto const status = H5Dread(
-                dataset, h5::memory_type<T>(), H5S_ALL, H5S_ALL, H5P_DEFAULT, buf
-            );
-            if (status < 0) {
-                throw h5::exception("failed to read from dataset");
+            auto const exists = H5Aexists(dataset, detail::catalog_valid_name());
+            if (exists < 0) {
+                throw h5::exception("failed to check catalog");
             }
-        }
-
-        template<>
-        inline
-        void read_dataset<std::string>(hid_t dataset, std::string* buf, std::size_t size)
-        {
-            std::vector<char*> tmpbuf(size, nullptr);
-            detail::h5_memory_guard<char*> guard(tmpbuf.data(), tmpbuf.size());
 
-            read_dataset(dataset, tmpbuf.data(), size);
+            h5::unique_hid<H5Aclose> attribute;
+            if (exists > 0) {
+                attribute = H5Aopen(dataset, detail::catalog_valid_name(), H5P_DEFAULT);
+            } else {
+                h5::unique_hid<H5Sclose> dataspace = H5Screate(H5S_SCALAR);
+                if (dataspace < 0) {
+                    throw h5::exception("failed to create catalog attribute dataspace");
+                }
+                attribute = H5Acreate2(
+                    dataset, detail::catalog_valid_name(), H5T_STD_U8LE, dataspace, H5P_DEFAULT, H5P_DEFAULT
+                );
+            }
+            if (attribute < 0) {
+                throw h5::exception("failed to open catalog attribute");
+            }
 
-            for (std::size_t i = 0; i < size; i++) {
-                // The stored string can be NULL.
-                buf[i] = tmpbuf[i] ? tmpbuf[i] : "";
+            std::uint8_t const value = valid ? 1 : 0;
+            if (H5Awrite(attribute, H5T_NATIVE_UINT8, &value) < 0) {
+                throw h5::exception("failed to write catalog attribute");
             }
         }
 
 
-        // Writes given buffer into dataset.
-        template<typename T>
-        void write_dataset(hid_t dataset, T const* buf, std::size_t)
+        // Flags the catalog stored in a file as stale.
+        inline void invalidate_catalog(hid_t file)
         {
-            auto const status = H5Dwrite(
-                dataset, h5::memory_type<T>(), H5S_ALL, H5S_ALL, H5P_DEFAULT, buf
-            );
-            if (status < 0) {
-                throw h5::exception("failed to write to dataset");
+            h5::unique_hid<H5Dclose> dataset = H5Dopen2(file, detail::catalog_path(), H5P_DEFAULT);
+            if (dataset < 0) {
+                throw h5::exception("failed to open catalog");
             }
+            detail::write_catalog_valid(dataset, false);
         }
 
-        template<>
-        inline
-        void write_dataset<std::string>(
-            hid_t dataset, std::string const* buf, std::size_t size
+
+        // Opens the stored catalog if its records can hold entries of given
+        // layout, and its extent can change. Returns an invalid handle
+        // otherwise, and sets `layout` to the stored one on success.
+        inline h5::unique_hid<H5Dclose> open_catalog_for_update(
+            hid_t file, detail::catalog_layout& layout
         )
         {
-            std::vector<char const*> tmpbuf(size, nullptr);
-            for (std::size_t i = 0; i < size; i++) {
-                tmpbuf[i] = buf[i].c_str();
+            auto const exists = H5Lexists(file, detail::catalog_path(), H5P_DEFAULT);
+            if (exists < 0) {
+                throw h5::exception("failed to check catalog");
+            }
+            if (exists == 0) {
+                return {};
+            }
+
+            h5::unique_hid<H5Dclose> dataset = H5Dopen2(file, detail::catalog_path(), H5P_DEFAULT);
+            if (dataset < 0) {
+                throw h5::exception("failed to open catalog");
+            }
+
+            h5::unique_hid<H5Tclose> file_type = H5Dget_type(dataset);
+            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
+            if (file_type < 0 || dataspace < 0) {
+                throw h5::exception("failed to inspect catalog");
+            }
+
+            hsize_t max_dims[1];
+            if (H5Sget_simple_extent_ndims(dataspace) != 1 ||
+                H5Sget_simple_extent_dims(dataspace, nullptr, max_dims) < 0 ||
+                max_dims[0] != H5S_UNLIMITED) {
+                return {};
             }
 
-            write_dataset(dataset, tmpbuf.data(), size);
+            auto const stored = detail::get_catalog_layout(file_type);
+            if (stored.max_rank < layout.max_rank || stored.path_size < layout.path_size) {
+                return {};
+            }
+            layout = stored;
+
+            return dataset;
         }
 
 
-        // Writes given buffer into dataset as an enum array.
-        template<typename T>
-        void write_enum_dataset(hid_t dataset, T const* buf, std::size_t, hid_t datatype)
+        // Replaces the catalog stored in a file. The catalog is resized and
+        // overwritten in place. It is recreated, with room to spare, only if
+        // a path or rank outgrows its records.
+        inline void store_catalog(hid_t file, std::vector<h5::object_info const*> const& entries)
         {
-            if (sizeof(T) != H5Tget_size(datatype)) {
-                throw h5::exception("buffer is incompatible with enum datatype");
+            detail::catalog_layout layout;
+            for (auto const entry : entries) {
+                layout.max_rank = std::max(layout.max_rank, entry->shape.size());
+                layout.path_size = std::max(layout.path_size, entry->path.size() + 1);
             }
 
-            auto const status = H5Dwrite(
-                dataset, datatype, H5S_ALL, H5S_ALL, H5P_DEFAULT, buf
-            );
-            if (status < 0) {
-                throw h5::exception("failed to write to enum dataset");
+            hsize_t const dims[] = {entries.size()};
+            auto dataset = detail::open_catalog_for_update(file, layout);
+
+            if (dataset >= 0) {
+                if (H5Dset_extent(dataset, dims) < 0) {
+                    throw h5::exception("failed to resize catalog");
+                }
+            } else {
+                if (H5Lexists(file, detail::catalog_path(), H5P_DEFAULT) > 0) {
+                    if (H5Ldelete(file, detail::catalog_path(), H5P_DEFAULT) < 0) {
+                        throw h5::exception("failed to delete old catalog");
+                    }
+                }
+
+                // Round up the record fields so that growing paths rarely
+                // force the catalog to be recreated.
+                std::size_t path_size = 64;
+                while (path_size < layout.path_size) {
+                    path_size *= 2;
+                }
+                layout.path_size = path_size;
+                layout.max_rank = std::max(layout.max_rank, std::size_t(4));
+
+                auto const file_type = detail::make_catalog_type(layout, true);
+
+                hsize_t const max_dims[] = {H5S_UNLIMITED};
+                h5::unique_hid<H5Sclose> dataspace = H5Screate_simple(1, dims, max_dims);
+                if (dataspace < 0) {
+                    throw h5::exception("failed to create catalog dataspace");
+                }
+
+                h5::unique_hid<H5Pclose> dataset_props = H5Pcreate(H5P_DATASET_CREATE);
+                if (dataset_props < 0) {
+                    throw h5::exception("failed to create catalog props");
+                }
+                hsize_t const chunk_dims[] = {
+                    std::max<hsize_t>(1, 4096 / layout.record_size())
+                };
+                if (H5Pset_chunk(dataset_props, 1, chunk_dims) < 0) {
+                    throw h5::exception("failed to set catalog chunk size");
+                }
+
+                dataset = H5Dcreate2(
+                    file, detail::catalog_path(), file_type, dataspace, H5P_DEFAULT, dataset_props, H5P_DEFAULT
+                );
+                if (dataset < 0) {
+                    throw h5::exception("failed to create catalog");
+                }
             }
-        }
-    }
 
+            std::vector<unsigned char> records(entries.size() * layout.record_size());
 
-    // Provides incremental write access to an unliimted HDF5 dataset.
-    //
-    // `stream_writer` incrementally writes arrays of rank `record_rank` to
-    // dataset of rank `record_rank + 1`. The first dimension is assumed to
-    // be unlimited.
-    //
-    template<typename D, int record_rank>
-    class stream_writer
-    {
-        static constexpr int data_rank = record_rank + 1;
+            for (std::size_t i = 0; i < entries.size(); i++) {
+                auto const record = records.data() + i * layout.record_size();
+                auto const& entry = *entries[i];
 
-    public:
-        // Constructor initiates writing to the dataset.
-        //
-        // Parameters:
-        //   file         = The file dataset resides in.
-        //   dataset      = The dataset to write to.
-        //   record_shape = Shape of each record (sub-array).
-        //
-        stream_writer(
-            hid_t file, hid_t dataset, h5::shape<record_rank> const& record_shape
-        )
-            : _file{file}, _dataset{dataset}, _record_shape{record_shape}
-        {
-            _maxdims[0] = H5S_UNLIMITED;
-            _datadims[0] = 0;
-            _memdims[0] = 1;
-            detail::set_dims(record_shape, _maxdims + 1);
-            detail::set_dims(record_shape, _datadims + 1);
-            detail::set_dims(record_shape, _memdims + 1);
+                std::uint64_t const value_size = entry.value_size;
+                std::uint64_t const storage_size = entry.storage_size;
+                std::int32_t const value_class = static_cast<std::int32_t>(entry.value_class);
+                std::int32_t const rank = static_cast<std::int32_t>(entry.shape.size());
+                std::memcpy(record, &value_size, sizeof value_size);
+                std::memcpy(record + 8, &storage_size, sizeof storage_size);
+                std::memcpy(record + 16, &value_class, sizeof value_class);
+                std::memcpy(record + 20, &rank, sizeof rank);
 
-            _dataspace = H5Screate_simple(data_rank, _datadims, _maxdims);
-            if (_dataspace < 0) {
-                throw h5::exception("failed to create dataspace");
+                for (std::size_t j = 0; j < entry.shape.size(); j++) {
+                    std::uint64_t const dim = entry.shape[j];
+                    std::memcpy(record + layout.shape_offset + j * sizeof dim, &dim, sizeof dim);
+                }
+
+                std::memcpy(record + layout.path_offset(), entry.path.data(), entry.path.size());
             }
 
-            _memspace = H5Screate_simple(data_rank, _memdims, nullptr);
-            if (_memspace < 0) {
-                throw h5::exception("failed to create dataspace");
+            if (!entries.empty()) {
+                auto const mem_type = detail::make_catalog_type(layout, false);
+                if (H5Dwrite(dataset, mem_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, records.data()) < 0) {
+                    throw h5::exception("failed to write catalog");
+                }
             }
+
+            detail::write_catalog_valid(dataset, true);
+        }
+
+
+        // Collects the datasets in a file by walking all groups.
+        inline std::vector<h5::object_info> build_catalog(hid_t file)
+        {
+            h5::list_options options;
+            options.recursive = true;
+
+            auto objects = detail::list_group(file, "/", options);
+
+            std::vector<h5::object_info> entries;
+            for (auto& object : objects) {
+                if (object.type == h5::object_type::dataset) {
+                    entries.push_back(std::move(object));
+                }
+            }
+            return entries;
+        }
+    }
+
+
+    // DATASET HANDLING ------------------------------------------------------
+
+    // Optional parameters passed to `dataset::write`.
+    struct dataset_options
+    {
+        // Enables deflate compression when set. The value designates the
+        // compression level: 0 for none, 1 for the fastest, 9 for the best.
+        //
+        // The minimum, fastest compression level 1 tends to be enough when
+        // `scaleoffset` is set to a proper value.
+        //
+        detail::optional<int> compression;
+
+        // Enables "scale-offset" lossy compression when set.
+        //
+        // This option is effective only for integral and floating-point
+        // dataset. For integral dataset, the value designates the number of
+        // retained bits. For floating-point dataset, the value designates the
+        // base-10 exponent of the scaling factor.
+        //
+        detail::optional<int> scaleoffset;
+
+        // Hints how the dataset is going to be accessed. The automatically
+        // chosen chunk shape suits the pattern. Effective only for chunked
+        // datasets, i.e., when compression is enabled, and for streams.
+        h5::access_pattern access = h5::access_pattern::any;
+
+        // Uses this chunk shape when set, instead of choosing one
+        // automatically. The dataset is chunked even if no filter is
+        // enabled. The length must be the rank of the dataset. Dimensions
+        // larger than the dataset shape are clipped.
+        detail::optional<std::vector<std::size_t>> chunk;
+
+        // Compresses chunks on this many threads when set. Zero uses all
+        // hardware threads.
+        //
+        // Chunks are filtered by this library and written with
+        // `H5Dwrite_chunk`, so the result is readable by stock HDF5. Deflate
+        // requires zlib: define `SNSINFU_H5_USE_ZLIB` and link with `-lz`.
+        // The option is ignored, i.e., HDF5 compresses chunks serially, if
+        // zlib is not enabled or `scaleoffset` is set.
+        //
+        detail::optional<unsigned> threads;
+
+        // Allocates the storage when the dataset is created rather than when
+        // data is first written. See `dataset::allocate`.
+        bool early_allocation = false;
+
+        // Chooses chunk shape and filters by trial when set. See
+        // `dataset::tune` for details. Explicit `chunk` and `scaleoffset`
+        // are kept as given; other storage options are overridden.
+        detail::optional<h5::tune_goal> tune;
+    };
+
+
+    // Optional parameters passed to `dataset::read`.
+    struct read_options
+    {
+        // Decompresses chunks on this many threads when set. Zero uses all
+        // hardware threads.
+        //
+        // Raw chunks are read with `H5Dread_chunk` and unfiltered by this
+        // library. Deflate requires zlib (see `dataset_options::threads`).
+        // The option is ignored, i.e., HDF5 reads the dataset serially, if
+        // the dataset uses other filters, has unallocated chunks, or the
+        // buffer type differs from the dataset type.
+        //
+        detail::optional<unsigned> threads;
+    };
+
+
+    // Optional parameters passed to `file::dataset` configuring the chunk
+    // cache of the dataset. Unset fields inherit the file defaults (1 MiB,
+    // 521 slots, 0.75). The settings are kept for the life of the `dataset`
+    // object, including datasets it recreates and its stream writers.
+    //
+    // The cache should hold every chunk one access touches. For example,
+    // reading a column of a matrix chunked by rows touches `rows / chunk
+    // rows` chunks; if they do not fit, each chunk is read and decompressed
+    // again for every column. Use `for_chunks` with the byte size from
+    // `dataset::chunk_shape` to derive the settings.
+    //
+    struct dataset_access_options
+    {
+        // Size of the chunk cache in bytes.
+        detail::optional<std::size_t> cache_bytes;
+
+        // Number of hash table slots in the chunk cache. This should be a
+        // prime about 100 times the number of chunks fitting in the cache.
+        detail::optional<std::size_t> cache_slots;
+
+        // Preemption policy between 0 and 1. Fully read or written chunks
+        // are preferentially evicted when 1. Use 1 for write-once or
+        // read-once access, and 0 if chunks are partially accessed again.
+        detail::optional<double> cache_w0;
+
+        // Returns options with a cache holding `chunk_count` chunks of
+        // `chunk_bytes` bytes each.
+        static dataset_access_options for_chunks(
+            std::size_t chunk_bytes, std::size_t chunk_count
+        )
+        {
+            dataset_access_options options;
+            options.cache_bytes = chunk_bytes * chunk_count;
+            options.cache_slots = detail::next_prime(100 * chunk_count);
+            return options;
+        }
+    };
+
+
+    namespace detail
+    {
+        // Creates dataset access props from options. Returns an empty
+        // handle if no option is set.
+        inline
+        h5::unique_hid<H5Pclose>
+        make_dataset_access_props(h5::dataset_access_options const& options)
+        {
+            if (!options.cache_bytes && !options.cache_slots && !options.cache_w0) {
+                return {};
+            }
+
+            h5::unique_hid<H5Pclose> access_props = H5Pcreate(H5P_DATASET_ACCESS);
+            if (access_props < 0) {
+                throw h5::exception("failed to create dataset access props");
+            }
+
+            std::size_t slots = H5D_CHUNK_CACHE_NSLOTS_DEFAULT;
+            std::size_t bytes = H5D_CHUNK_CACHE_NBYTES_DEFAULT;
+            double w0 = H5D_CHUNK_CACHE_W0_DEFAULT;
+
+            if (options.cache_slots) {
+                slots = *options.cache_slots;
+            }
+            if (options.cache_bytes) {
+                bytes = *options.cache_bytes;
+            }
+            if (options.cache_w0) {
+                w0 = *options.cache_w0;
+            }
+
+            if (H5Pset_chunk_cache(access_props, slots, bytes, w0) < 0) {
+                throw h5::exception("failed to set chunk cache");
+            }
+
+            return access_props;
+        }
+    }
+
+
+    // Optional parameters passed to `dataset::stream_writer`.
+    struct stream_options
+    {
+        // Enables buffered writing when set.
+        //
+        // A buffered stream stages records in memory and writes them to the
+        // dataset in chunk-sized batches. The extent of the dataset grows
+        // geometrically while streaming, so the dataset may temporarily hold
+        // more records than written. The extent is trimmed to the exact
+        // number of records on `flush` or destruction.
+        //
+        bool buffered = false;
+
+        // Writes records on a background thread when set. This implies
+        // `buffered`.
+        //
+        // Full staging buffers are handed over to the background thread so
+        // that the caller can continue computing while HDF5 compresses and
+        // writes the records. An error occurred in the background thread
+        // is rethrown on the next `write` or `flush`.
+        //
+        bool async = false;
+
+        // Number of staging buffers an asynchronous stream may have in
+        // flight. `write` blocks when all of them are waiting to be written.
+        std::size_t queue_depth = 2;
+
+        // Resumes appending to the dataset if it exists when set.
+        //
+        // The existing dataset must be chunked and have unlimited first
+        // dimension, and its records must have the same shape as requested.
+        // New records are appended after the current extent. If a buffered
+        // stream was killed before trimming the dataset, the dataset is
+        // trimmed to the records written out before the stream last grew or
+        // trimmed it, so the stream resumes without a gap of fill values.
+        //
+        bool append = false;
+
+        // Writes whole chunks directly when set. This implies `buffered`.
+        //
+        // Staged records are assembled into whole chunks, filtered by this
+        // library and written exactly once with `H5Dwrite_chunk`, bypassing
+        // the chunk cache and the HDF5 filter pipeline. A partial chunk at
+        // the end is written through HDF5 on `flush` or destruction. Deflate
+        // requires zlib (see `dataset_options::threads`); the option is
+        // ignored if the dataset uses other filters.
+        //
+        bool direct_chunk = false;
+    };
+
+
+    // Optional parameters passed to `dataset::stream_reader`.
+    struct stream_reader_options
+    {
+        // Reads the next block of records on a background thread while the
+        // current block is consumed.
+        bool prefetch = false;
+    };
+
+
+    // Determines when written data is flushed to disk. Passed to `h5::file`
+    // as a part of `file_options` and followed by every dataset and stream
+    // writer opened from the file.
+    //
+    // Data is flushed when any of the enabled conditions is met. Conditions
+    // are checked on each write, so no flush happens while the application
+    // is not writing. Set all fields to zero to flush only on explicit
+    // `file::flush` and on close.
+    //
+    struct flush_policy
+    {
+        // Flushes after this many writes. Zero disables the condition. The
+        // default flushes after every write.
+        std::size_t writes = 1;
+
+        // Flushes after this many bytes are written. Zero disables the
+        // condition.
+        std::size_t bytes = 0;
+
+        // Flushes on a write if this many seconds have passed since the last
+        // flush. Zero disables the condition.
+        double seconds = 0;
+
+        // Returns a policy that flushes only on explicit `file::flush` and
+        // on close.
+        static flush_policy manual()
+        {
+            return {0, 0, 0};
+        }
+    };
+
+
+    namespace detail
+    {
+        // State shared by a file and the objects opened from it.
+        class file_state
+        {
+        public:
+            // Parameters:
+            //   file       = The file.
+            //   policy     = Flush policy followed on writes.
+            //   cache_size = Maximum number of cached dataset handles.
+            //
+            file_state(hid_t file, h5::flush_policy const& policy, std::size_t cache_size)
+                : _policy{policy}, _last_flush{clock::now()}, _cache_size{cache_size}
+            {
+                // Hold a reference of our own so that datasets outliving the
+                // `h5::file` keep a valid handle to the file.
+                if (H5Iinc_ref(file) < 0) {
+                    throw h5::exception("failed to share file handle");
+                }
+                _file = file;
+            }
+
+            // Stores changes to the catalog made through datasets after the
+            // `h5::file` is closed.
+            ~file_state()
+            {
+                try {
+                    store_catalog();
+                } catch (...) {
+                }
+            }
+
+            // Records a completed write of given size to `path` and flushes
+            // the file if the flush policy says so.
+            void notify_write(std::string const& path, std::size_t bytes)
+            {
+                touch_catalog(path);
+
+                _writes++;
+                _bytes += bytes;
+
+                if (_policy.writes > 0 && _writes >= _policy.writes) {
+                    return flush();
+                }
+                if (_policy.bytes > 0 && _bytes >= _policy.bytes) {
+                    return flush();
+                }
+                if (_policy.seconds > 0) {
+                    std::chrono::duration<double> const elapsed = clock::now() - _last_flush;
+                    if (elapsed.count() >= _policy.seconds) {
+                        return flush();
+                    }
+                }
+            }
+
+            // Flushes the file.
+            void flush()
+            {
+                if (H5Fflush(_file, H5F_SCOPE_LOCAL) < 0) {
+                    throw h5::exception("failed to flush changes to disk");
+                }
+                _writes = 0;
+                _bytes = 0;
+                _last_flush = clock::now();
+            }
+
+
+            // Dataset handle cached with its rank, shape and datatype.
+            struct dataset_entry
+            {
+                h5::unique_hid<H5Dclose> dataset;
+                h5::unique_hid<H5Tclose> datatype;
+                detail::object_address address;
+                int rank = 0;
+                hsize_t dims[H5S_MAX_RANK] = {};
+
+                // True if the shape cannot change unless the dataset is
+                // recreated, i.e., the dataset is not extendible.
+                bool fixed_shape = false;
+            };
+
+
+            // Returns true if dataset handles are cached.
+            bool caches_datasets() const noexcept
+            {
+                return _cache_size > 0;
+            }
+
+
+            // Returns the cached entry of the dataset on `path`. The dataset
+            // is opened and cached on first access. Returns nullptr if the
+            // path does not exist.
+            //
+            // A cached entry is used only if it is still the dataset linked
+            // at the path (see `is_current`), so datasets replaced or
+            // unlinked by other means than `invalidate` are reopened. The
+            // least recently used entry is dropped when the cache is full.
+            // The returned pointer is valid until the next call.
+            //
+            dataset_entry const* find_dataset(std::string const& path)
+            {
+                auto const key = cache_key(path);
+
+                auto const it = _dataset_index.find(key);
+                if (it != _dataset_index.end()) {
+                    auto const item = it->second;
+                    if (is_current(item->second, path)) {
+                        _datasets.splice(_datasets.begin(), _datasets, item);
+                        return &item->second;
+                    }
+                    _datasets.erase(item);
+                    _dataset_index.erase(it);
+                }
+
+                if (!detail::check_path_exists(_file, path)) {
+                    return nullptr;
+                }
+
+                dataset_entry entry;
+
+                entry.dataset = H5Dopen2(_file, path.c_str(), H5P_DEFAULT);
+                if (entry.dataset < 0) {
+                    throw h5::exception("failed to open dataset");
+                }
+
+                // An entry reached through a soft link never validates and
+                // is reopened on every access.
+                if (!detail::get_link_address(_file, path.c_str(), entry.address)) {
+                    entry.address = detail::get_object_address(entry.dataset, ".");
+                }
+
+                entry.datatype = H5Dget_type(entry.dataset);
+                if (entry.datatype < 0) {
+                    throw h5::exception("failed to determine datatype");
+                }
+
+                h5::unique_hid<H5Sclose> dataspace = H5Dget_space(entry.dataset);
+                if (dataspace < 0) {
+                    throw h5::exception("failed to determine dataspace");
+                }
+
+                hsize_t max_dims[H5S_MAX_RANK];
+                entry.rank = H5Sget_simple_extent_dims(dataspace, entry.dims, max_dims);
+                if (entry.rank < 0) {
+                    throw h5::exception("failed to determine dataset shape");
+                }
+                entry.fixed_shape = std::equal(entry.dims, entry.dims + entry.rank, max_dims);
+
+                while (!_datasets.empty() && _datasets.size() >= _cache_size) {
+                    _dataset_index.erase(_datasets.back().first);
+                    _datasets.pop_back();
+                }
+                _datasets.emplace_front(key, std::move(entry));
+                _dataset_index.emplace(key, _datasets.begin());
+
+                return &_datasets.front().second;
+            }
+
+
+            // Drops the cached dataset on `path` and any cached dataset under
+            // it. Called when the object on `path` is replaced.
+            void invalidate(std::string const& path)
+            {
+                auto const key = cache_key(path);
+                auto const prefix = key + '/';
+
+                for (auto item = _datasets.begin(); item != _datasets.end(); ) {
+                    auto const& item_key = item->first;
+                    if (item_key == key || item_key.compare(0, prefix.size(), prefix) == 0) {
+                        _dataset_index.erase(item_key);
+                        item = _datasets.erase(item);
+                    } else {
+                        ++item;
+                    }
+                }
+                touch_catalog(path);
+            }
+
+
+            // Prepares the catalog of datasets. If `enabled`, the catalog
+            // stored in the file is loaded, or built by walking the file if
+            // there is none or it is stale. Otherwise, a stored catalog is only
+            // watched so that it is flagged stale when the file is modified.
+            void open_catalog(bool enabled)
+            {
+                unsigned intent;
+                if (H5Fget_intent(_file, &intent) < 0) {
+                    throw h5::exception("failed to get file intent");
+                }
+                bool const writable = intent & H5F_ACC_RDWR;
+
+                if (!enabled && !writable) {
+                    return;
+                }
+
+                _catalog_stored = detail::check_catalog_valid(_file);
+
+                if (!enabled) {
+                    return;
+                }
+                _catalog_enabled = true;
+
+                auto entries = _catalog_stored ?
+                    detail::load_catalog(_file) : detail::build_catalog(_file);
+                for (auto& entry : entries) {
+                    auto key = entry.path;
+                    _catalog.emplace(std::move(key), std::move(entry));
+                }
+
+                // Built catalog is stored on flush or close.
+                _catalog_dirty = writable && !_catalog_stored;
+            }
+
+
+            // Returns true if the catalog is enabled.
+            bool has_catalog() const noexcept
+            {
+                return _catalog_enabled;
+            }
+
+
+            // Returns the catalog entry of the dataset on `path`, or nullptr
+            // if there is no such dataset.
+            h5::object_info const* find_catalog(std::string const& path)
+            {
+                refresh_catalog();
+
+                auto const it = _catalog.find(cache_key(path));
+                if (it == _catalog.end()) {
+                    return nullptr;
+                }
+                return &it->second;
+            }
+
+
+            // Returns all catalog entries sorted by path.
+            std::vector<h5::object_info const*> catalog_entries()
+            {
+                refresh_catalog();
+
+                std::vector<h5::object_info const*> entries;
+                for (auto const& item : _catalog) {
+                    entries.push_back(&item.second);
+                }
+                std::sort(entries.begin(), entries.end(), [](auto lhs, auto rhs) {
+                    return lhs->path < rhs->path;
+                });
+                return entries;
+            }
+
+
+            // Stores the catalog into the file if it has been modified.
+            void store_catalog()
+            {
+                if (!_catalog_dirty) {
+                    return;
+                }
+                detail::store_catalog(_file, catalog_entries());
+                _catalog_stored = true;
+                _catalog_dirty = false;
+            }
+
+        private:
+            using clock = std::chrono::steady_clock;
+
+            // Normalizes `path` so that equivalent paths share an entry.
+            static std::string cache_key(std::string const& path)
+            {
+                auto const start = path.find_first_not_of('/');
+                return start == std::string::npos ? "" : path.substr(start);
+            }
+
+
+            // Returns true if `entry` is still the dataset linked at `path`.
+            // The cached handle keeps the object open, and HDF5 does not free
+            // the space of an open object even if it is unlinked, so the
+            // address cannot be reused by a new object while the entry is
+            // cached. An entry is current if its handle is valid, the object
+            // still has a link, and `path` links to the object's address.
+            bool is_current(dataset_entry const& entry, std::string const& path) const
+            {
+                if (H5Iis_valid(entry.dataset) <= 0) {
+                    return false;
+                }
+                if (detail::get_link_count(entry.dataset) == 0) {
+                    return false;
+                }
+
+                detail::object_address address;
+                if (!detail::get_link_address(_file, path.c_str(), address)) {
+                    return false;
+                }
+                return detail::same_object_address(_file, entry.address, address);
+            }
+
+
+            // Records a modification of the dataset on `path`. The stored
+            // catalog is flagged stale on the first modification so that a
+            // crash never leaves it trusted.
+            void touch_catalog(std::string const& path)
+            {
+                if (_catalog_stored) {
+                    detail::invalidate_catalog(_file);
+                    _catalog_stored = false;
+                }
+
+                if (_catalog_enabled) {
+                    _catalog_stale.insert(cache_key(path));
+                    _catalog_dirty = true;
+                }
+            }
+
+
+            // Updates the catalog entries of modified datasets.
+            void refresh_catalog()
+            {
+                for (auto const& key : _catalog_stale) {
+                    _catalog.erase(key);
+
+                    if (detail::is_catalog_path(key) || !detail::check_path_exists(_file, key)) {
+                        continue;
+                    }
+                    if (detail::get_object_type(_file, key.c_str()) != h5::object_type::dataset) {
+                        continue;
+                    }
+
+                    h5::object_info entry;
+                    entry.path = key;
+                    entry.type = h5::object_type::dataset;
+                    detail::get_dataset_info(_file, key.c_str(), entry);
+                    _catalog.emplace(key, std::move(entry));
+                }
+                _catalog_stale.clear();
+            }
+
+            h5::unique_hid<H5Fclose> _file;
+            h5::flush_policy _policy;
+            std::size_t _writes = 0;
+            std::size_t _bytes = 0;
+            clock::time_point _last_flush;
+            std::size_t _cache_size;
+            std::list<std::pair<std::string, dataset_entry>> _datasets;
+            std::unordered_map<
+                std::string,
+                std::list<std::pair<std::string, dataset_entry>>::iterator
+            > _dataset_index;
+            bool _catalog_enabled = false;
+            bool _catalog_stored = false;
+            bool _catalog_dirty = false;
+            std::unordered_map<std::string, h5::object_info> _catalog;
+            std::unordered_set<std::string> _catalog_stale;
+        };
+
+
+        // Notifies modification of `path` to the file state, if any.
+        inline void notify_modify(detail::file_state* state, std::string const& path)
+        {
+            if (state) {
+                state->invalidate(path);
+            }
+        }
+
+
+        // Notifies a completed write to `path` to the file state. Objects not
+        // opened from an `h5::file` have no state and flush after every write.
+        inline void notify_write(
+            detail::file_state* state, hid_t file, std::string const& path, std::size_t bytes
+        )
+        {
+            if (state) {
+                state->notify_write(path, bytes);
+                return;
+            }
+            if (H5Fflush(file, H5F_SCOPE_LOCAL) < 0) {
+                throw h5::exception("failed to flush changes to disk");
+            }
+        }
+    }
+
+
+    namespace detail
+    {
+        // Checks the rank of a dataset. Throws an exception if the actual rank
+        // is not the expected `rank`. Otherwise, returns the shape.
+        template<int rank>
+        h5::shape<rank> check_dataset_rank(hid_t dataset)
+        {
+            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
+            if (dataspace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+
+            auto const dataset_rank = H5Sget_simple_extent_ndims(dataspace);
+            if (dataset_rank != rank) {
+                throw h5::exception("unexpected dataset rank");
+            }
+
+            hsize_t dims[rank];
+            if (H5Sget_simple_extent_dims(dataspace, dims, nullptr) < 0) {
+                throw h5::exception("failed to determine dataset shape");
+            }
+
+            h5::shape<rank> shape;
+            detail::set_dims(dims, shape);
+            return shape;
+        }
+
+        template<>
+        inline h5::shape<0> check_dataset_rank<0>(hid_t dataset)
+        {
+            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
+            if (dataspace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+
+            auto const dataset_rank = H5Sget_simple_extent_ndims(dataspace);
+            if (dataset_rank != 0) {
+                throw h5::exception("unexpected dataset rank");
+            }
+
+            return {};
+        }
+
+
+        // Checks if `datatype` is compatible with `D`. Throws an exception if
+        // the types are incompatible.
+        template<typename D>
+        void check_datatype(hid_t datatype)
+        {
+            H5T_cdata_t* cdata = nullptr;
+            if (H5Tfind(datatype, h5::storage_type<D>(), &cdata) == nullptr) {
+                throw h5::exception("incompatible dataset type");
+            }
+        }
+
+
+        // Checks if the datatype of `dataset` is compatible with `D`. Throws
+        // an exception if the types are incompatible. Returns a datatype hid
+        // of the dataset on success.
+        template<typename D>
+        h5::unique_hid<H5Tclose> check_dataset_type(hid_t dataset)
+        {
+            h5::unique_hid<H5Tclose> datatype = H5Dget_type(dataset);
+            if (datatype < 0) {
+                throw h5::exception("failed to determine datatype");
+            }
+
+            detail::check_datatype<D>(datatype);
+
+            return datatype;
+        }
+
+
+        // Checks if the datatype of `dataset` is an enum that matches given
+        // definition. Throws an `h5::exception` if not.
+        template<typename D>
+        void check_dataset_enums(hid_t dataset, h5::enums<D> const& enums)
+        {
+            h5::unique_hid<H5Tclose> datatype = H5Dget_type(dataset);
+            if (datatype < 0) {
+                throw h5::exception("failed to determine enum datatype");
+            }
+
+            detail::check_enum_type(datatype, enums);
+        }
+
+
+        template<typename D>
+        H5Z_SO_scale_type_t determine_scaleoffset_type()
+        {
+            if (std::is_floating_point<D>::value) {
+                return H5Z_SO_FLOAT_DSCALE;
+            }
+            if (std::is_integral<D>::value) {
+                return H5Z_SO_INT;
+            }
+            throw h5::exception("cannot apply scaleoffset to specified datatype");
+        }
+
+
+        // Adds filters requested in `options` to dataset creation props.
+        template<typename D>
+        void set_dataset_filters(hid_t dataset_props, h5::dataset_options const& options)
+        {
+            if (options.scaleoffset) {
+                auto const type = detail::determine_scaleoffset_type<D>();
+                auto const factor = *options.scaleoffset;
+
+                if (H5Pset_scaleoffset(dataset_props, type, factor) < 0) {
+                    throw h5::exception("failed to set shuffle filter");
+                }
+            }
+
+            if (options.compression) {
+                auto const level = static_cast<unsigned>(*options.compression);
+
+                if (H5Pset_shuffle(dataset_props) < 0) {
+                    throw h5::exception("failed to set shuffle filter");
+                }
+                if (H5Pset_deflate(dataset_props, level) < 0) {
+                    throw h5::exception("failed to set deflate filter");
+                }
+            }
+        }
+
+
+        // Creates link creation props that allow intermediate groups to be
+        // automatically created.
+        inline h5::unique_hid<H5Pclose> make_link_props()
+        {
+            h5::unique_hid<H5Pclose> link_props = H5Pcreate(H5P_LINK_CREATE);
+            if (link_props < 0) {
+                throw h5::exception("failed to create link props");
+            }
+            if (H5Pset_create_intermediate_group(link_props, 1) < 0) {
+                throw h5::exception("failed to configure link props");
+            }
+            return link_props;
+        }
+
+
+        // Copies the explicit chunk shape in `options` to `dims`. Throws an
+        // exception if the chunk shape is invalid.
+        inline void get_explicit_chunk(
+            h5::dataset_options const& options, int rank, hsize_t* dims
+        )
+        {
+            auto const& chunk = *options.chunk;
+
+            if (chunk.size() != static_cast<std::size_t>(rank)) {
+                throw h5::exception("chunk rank mismatch");
+            }
+            for (int i = 0; i < rank; i++) {
+                auto const dim = chunk[static_cast<std::size_t>(i)];
+                if (dim == 0) {
+                    throw h5::exception("chunk dimension must be positive");
+                }
+                dims[i] = static_cast<hsize_t>(dim);
+            }
+        }
+
+
+        // Creates dataset creation props for a simple dataset.
+        template<typename D, int rank>
+        h5::unique_hid<H5Pclose> make_simple_dataset_props(
+            h5::shape<rank> const& shape, h5::dataset_options const& options
+        )
+        {
+            h5::unique_hid<H5Pclose> dataset_props = H5Pcreate(H5P_DATASET_CREATE);
+            if (dataset_props < 0) {
+                throw h5::exception("failed to create dataset props");
+            }
+
+            hsize_t chunk_dims[rank];
+            bool chunked = false;
+
+            if (options.chunk) {
+                detail::get_explicit_chunk(options, rank, chunk_dims);
+                for (int i = 0; i < rank; i++) {
+                    chunk_dims[i] = std::max(
+                        std::min(chunk_dims[i], hsize_t(shape.dims[i])), hsize_t(1)
+                    );
+                }
+                chunked = true;
+            } else if (options.compression || options.scaleoffset) {
+                auto const chunk = detail::determine_chunk_size(shape, sizeof(D), options.access);
+                set_dims(chunk, chunk_dims);
+                chunked = true;
+            }
+
+            if (chunked) {
+                if (H5Pset_chunk(dataset_props, rank, chunk_dims) < 0) {
+                    throw h5::exception("failed to set chunk size");
+                }
+            }
+
+            detail::set_dataset_filters<D>(dataset_props, options);
+
+            if (options.early_allocation) {
+                if (H5Pset_alloc_time(dataset_props, H5D_ALLOC_TIME_EARLY) < 0) {
+                    throw h5::exception("failed to set allocation time");
+                }
+            }
+
+            return dataset_props;
+        }
+
+
+        // Returns true if two dataset creation props specify the same layout,
+        // chunk size and filters, and `props1` allocates storage early if
+        // `props2` does.
+        inline bool same_storage_props(hid_t props1, hid_t props2)
+        {
+            auto const layout = H5Pget_layout(props1);
+            if (layout < 0 || layout != H5Pget_layout(props2)) {
+                return false;
+            }
+
+            H5D_alloc_time_t alloc_time1;
+            H5D_alloc_time_t alloc_time2;
+            if (H5Pget_alloc_time(props1, &alloc_time1) < 0) {
+                return false;
+            }
+            if (H5Pget_alloc_time(props2, &alloc_time2) < 0) {
+                return false;
+            }
+            if (alloc_time2 == H5D_ALLOC_TIME_EARLY && alloc_time1 != H5D_ALLOC_TIME_EARLY) {
+                return false;
+            }
+
+            if (layout == H5D_CHUNKED) {
+                hsize_t chunk1[H5S_MAX_RANK];
+                hsize_t chunk2[H5S_MAX_RANK];
+                auto const rank = H5Pget_chunk(props1, H5S_MAX_RANK, chunk1);
+                if (rank < 0 || rank != H5Pget_chunk(props2, H5S_MAX_RANK, chunk2)) {
+                    return false;
+                }
+                if (!std::equal(chunk1, chunk1 + rank, chunk2)) {
+                    return false;
+                }
+            }
+
+            auto const filter_count = H5Pget_nfilters(props1);
+            if (filter_count < 0 || filter_count != H5Pget_nfilters(props2)) {
+                return false;
+            }
+
+            for (unsigned i = 0; i < static_cast<unsigned>(filter_count); i++) {
+                constexpr std::size_t max_values = 32;
+                unsigned flags;
+                unsigned values1[max_values];
+                unsigned values2[max_values];
+                std::size_t count1 = max_values;
+                std::size_t count2 = max_values;
+
+                auto const filter1 = H5Pget_filter2(
+                    props1, i, &flags, &count1, values1, 0, nullptr, nullptr
+                );
+                auto const filter2 = H5Pget_filter2(
+                    props2, i, &flags, &count2, values2, 0, nullptr, nullptr
+                );
+                if (filter1 < 0 || filter1 != filter2) {
+                    return false;
+                }
+
+                // Filters append parameters when a dataset is created. Only
+                // compare user-supplied ones.
+                auto const count = std::min({count1, count2, max_values});
+                if (!std::equal(values1, values1 + count, values2)) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+
+        // Returns true if `dataset` has given datatype, shape and storage
+        // options so that it can be overwritten in place.
+        template<typename D, int rank>
+        bool is_overwritable(
+            hid_t dataset,
+            hid_t datatype,
+            h5::shape<rank> const& shape,
+            h5::dataset_options const& options
+        )
+        {
+            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
+            if (dataspace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+            if (H5Sget_simple_extent_ndims(dataspace) != rank) {
+                return false;
+            }
+
+            hsize_t expected_dims[rank];
+            hsize_t dims[rank];
+            hsize_t max_dims[rank];
+            detail::set_dims(shape, expected_dims);
+            if (H5Sget_simple_extent_dims(dataspace, dims, max_dims) < 0) {
+                throw h5::exception("failed to determine dataset shape");
+            }
+            if (!std::equal(dims, dims + rank, expected_dims)) {
+                return false;
+            }
+            if (!std::equal(max_dims, max_dims + rank, expected_dims)) {
+                return false;
+            }
+
+            h5::unique_hid<H5Tclose> dataset_type = H5Dget_type(dataset);
+            if (dataset_type < 0 || H5Tequal(dataset_type, datatype) <= 0) {
+                return false;
+            }
+
+            h5::unique_hid<H5Pclose> dataset_props = H5Dget_create_plist(dataset);
+            if (dataset_props < 0) {
+                throw h5::exception("failed to get dataset props");
+            }
+            auto const expected_props = detail::make_simple_dataset_props<D>(shape, options);
+
+            return detail::same_storage_props(dataset_props, expected_props);
+        }
+
+
+        // Creates a new simple dataset.
+        template<typename D, int rank>
+        h5::unique_hid<H5Dclose> create_simple_dataset(
+            hid_t file,
+            std::string const& path,
+            hid_t datatype,
+            h5::shape<rank> const& shape,
+            h5::dataset_options const& options,
+            hid_t access_props = H5P_DEFAULT
+        )
+        {
+            hsize_t dims[rank];
+            detail::set_dims(shape, dims);
+
+            h5::unique_hid<H5Sclose> dataspace = H5Screate_simple(rank, dims, nullptr);
+            if (dataspace < 0) {
+                throw h5::exception("failed to create dataspace");
+            }
+
+            auto const link_props = detail::make_link_props();
+            auto const dataset_props = detail::make_simple_dataset_props<D>(shape, options);
+
+            h5::unique_hid<H5Dclose> dataset = H5Dcreate2(
+                file,
+                path.c_str(),
+                datatype,
+                dataspace,
+                link_props,
+                dataset_props,
+                access_props
+            );
+            if (dataset < 0) {
+                throw h5::exception("failed to create dataset");
+            }
+
+            return dataset;
+        }
+
+
+        // Creates a new simple dataset with unlimited first dimension.
+        template<typename D, int record_rank>
+        h5::unique_hid<H5Dclose> create_unlimited_dataset(
+            hid_t file,
+            std::string const& path,
+            hid_t datatype,
+            h5::shape<record_rank> const& record_shape,
+            h5::dataset_options const& options,
+            hid_t access_props = H5P_DEFAULT
+        )
+        {
+            static constexpr int data_rank = record_rank + 1;
+
+            hsize_t dims[data_rank];
+            dims[0] = 0;
+            detail::set_dims(record_shape, dims + 1);
+
+            hsize_t max_dims[data_rank];
+            max_dims[0] = H5S_UNLIMITED;
+            detail::set_dims(record_shape, max_dims + 1);
+
+            h5::unique_hid<H5Sclose> dataspace = H5Screate_simple(data_rank, dims, max_dims);
+            if (dataspace < 0) {
+                throw h5::exception("failed to create dataspace");
+            }
+
+            auto const link_props = detail::make_link_props();
+
+            h5::unique_hid<H5Pclose> dataset_props = H5Pcreate(H5P_DATASET_CREATE);
+            if (dataset_props < 0) {
+                throw h5::exception("failed to create dataset props");
+            }
+
+            // Unlimited dataset is always chunked. We first chunk record. If
+            // a whole record may fit in a chunk, we extend the chunk so that
+            // multiple records are stored in a chunk.
+            constexpr std::size_t KiB = 1024;
+            constexpr std::size_t base_size = 24 * KiB; // Arbitrary
+
+            hsize_t chunk_dims[data_rank];
+
+            if (options.chunk) {
+                detail::get_explicit_chunk(options, data_rank, chunk_dims);
+                for (int i = 0; i < record_rank; i++) {
+                    chunk_dims[i + 1] = std::max(
+                        std::min(chunk_dims[i + 1], hsize_t(record_shape.dims[i])), hsize_t(1)
+                    );
+                }
+            } else {
+                auto record_chunk = detail::determine_chunk_size(
+                    record_shape, sizeof(D), options.access
+                );
+
+                // Reading a column across records should touch few chunks, so
+                // shrink records so that a chunk holds many of them.
+                if (options.access == h5::access_pattern::column_scan) {
+                    constexpr std::size_t min_records = 64;
+
+                    for (int axis = record_rank - 1; axis >= 0; ) {
+                        if (record_chunk.size() * sizeof(D) * min_records <= base_size) {
+                            break;
+                        }
+                        if (record_chunk.dims[axis] == 1) {
+                            axis--;
+                            continue;
+                        }
+                        record_chunk.dims[axis] = (record_chunk.dims[axis] + 1) / 2;
+                    }
+                }
+
+                auto const stream_chunk = 1 + base_size / (record_chunk.size() * sizeof(D));
+
+                chunk_dims[0] = static_cast<hsize_t>(stream_chunk);
+                set_dims(record_chunk, chunk_dims + 1);
+            }
+
+            if (H5Pset_chunk(dataset_props, data_rank, chunk_dims) < 0) {
+                throw h5::exception("failed to set chunk size");
+            }
+
+            detail::set_dataset_filters<D>(dataset_props, options);
+
+            h5::unique_hid<H5Dclose> dataset = H5Dcreate2(
+                file,
+                path.c_str(),
+                datatype,
+                dataspace,
+                link_props,
+                dataset_props,
+                access_props
+            );
+            if (dataset < 0) {
+                throw h5::exception("failed to create unlimited dataset");
+            }
+
+            return dataset;
+        }
+
+        // Creates a new scalar dataset.
+        template<typename D>
+        h5::unique_hid<H5Dclose> create_scalar_dataset(
+            hid_t file, std::string const& path, hid_t datatype
+        )
+        {
+            h5::unique_hid<H5Sclose> dataspace = H5Screate(H5S_SCALAR);
+            if (dataspace < 0) {
+                throw h5::exception("failed to create dataspace");
+            }
+
+            auto const link_props = detail::make_link_props();
+
+            h5::unique_hid<H5Dclose> dataset = H5Dcreate2(
+                file,
+                path.c_str(),
+                datatype,
+                dataspace,
+                link_props,
+                H5P_DEFAULT,
+                H5P_DEFAULT
+            );
+            if (dataset < 0) {
+                throw h5::exception("failed to create dataset");
+            }
+
+            return dataset;
+        }
+
+
+        // Reads dataset into given buffer. Optional `memspace` and `filespace`
+        // restrict the transfer to a selection.
+        template<typename T>
+        void read_dataset(
+            hid_t dataset,
+            T* buf,
+            std::size_t,
+            hid_t memspace = H5S_ALL,
+            hid_t filespace = H5S_ALL
+        )
+        {
+            auto const status = H5Dread(
+                dataset, h5::memory_type<T>(), memspace, filespace, H5P_DEFAULT, buf
+            );
+            if (status < 0) {
+                throw h5::exception("failed to read from dataset");
+            }
+        }
+
+        template<>
+        inline
+        void read_dataset<std::string>(
+            hid_t dataset,
+            std::string* buf,
+            std::size_t size,
+            hid_t memspace,
+            hid_t filespace
+        )
+        {
+            std::vector<char*> tmpbuf(size, nullptr);
+            detail::h5_memory_guard<char*> guard(tmpbuf.data(), tmpbuf.size());
+
+            read_dataset(dataset, tmpbuf.data(), size, memspace, filespace);
+
+            for (std::size_t i = 0; i < size; i++) {
+                // The stored string can be NULL.
+                buf[i] = tmpbuf[i] ? tmpbuf[i] : "";
+            }
+        }
+
+
+        // Writes given buffer into dataset. Optional `memspace` and
+        // `filespace` restrict the transfer to a selection.
+        template<typename T>
+        void write_dataset(
+            hid_t dataset,
+            T const* buf,
+            std::size_t,
+            hid_t memspace = H5S_ALL,
+            hid_t filespace = H5S_ALL
+        )
+        {
+            auto const status = H5Dwrite(
+                dataset, h5::memory_type<T>(), memspace, filespace, H5P_DEFAULT, buf
+            );
+            if (status < 0) {
+                throw h5::exception("failed to write to dataset");
+            }
+        }
+
+        template<>
+        inline
+        void write_dataset<std::string>(
+            hid_t dataset,
+            std::string const* buf,
+            std::size_t size,
+            hid_t memspace,
+            hid_t filespace
+        )
+        {
+            std::vector<char const*> tmpbuf(size, nullptr);
+            for (std::size_t i = 0; i < size; i++) {
+                tmpbuf[i] = buf[i].c_str();
+            }
+
+            write_dataset(dataset, tmpbuf.data(), size, memspace, filespace);
+        }
+
+
+        // Writes given buffer into dataset as an enum array.
+        template<typename T>
+        void write_enum_dataset(
+            hid_t dataset,
+            T const* buf,
+            std::size_t,
+            hid_t datatype,
+            hid_t memspace = H5S_ALL,
+            hid_t filespace = H5S_ALL
+        )
+        {
+            if (sizeof(T) != H5Tget_size(datatype)) {
+                throw h5::exception("buffer is incompatible with enum datatype");
+            }
+
+            auto const status = H5Dwrite(
+                dataset, datatype, memspace, filespace, H5P_DEFAULT, buf
+            );
+            if (status < 0) {
+                throw h5::exception("failed to write to enum dataset");
+            }
+        }
+
+
+        // Selects a strided hyperslab in the dataspace of `dataset`. Throws
+        // an exception if the slice does not fit in the dataset.
+        template<int rank>
+        h5::unique_hid<H5Sclose> select_slice(
+            hid_t dataset,
+            h5::shape<rank> const& offset,
+            h5::shape<rank> const& count,
+            h5::shape<rank> const& stride
+        )
+        {
+            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
+            if (dataspace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+
+            hsize_t dims[rank];
+            if (H5Sget_simple_extent_dims(dataspace, dims, nullptr) != rank) {
+                throw h5::exception("unexpected dataset rank");
+            }
+
+            hsize_t start_dims[rank];
+            hsize_t count_dims[rank];
+            hsize_t stride_dims[rank];
+            detail::set_dims(offset, start_dims);
+            detail::set_dims(count, count_dims);
+            detail::set_dims(stride, stride_dims);
+
+            for (int i = 0; i < rank; i++) {
+                if (stride_dims[i] == 0) {
+                    throw h5::exception("slice stride must be positive");
+                }
+                if (count_dims[i] == 0) {
+                    continue;
+                }
+                auto const last = start_dims[i] + (count_dims[i] - 1) * stride_dims[i];
+                if (last >= dims[i]) {
+                    throw h5::exception("slice is out of dataset bounds");
+                }
+            }
+
+            auto const status = H5Sselect_hyperslab(
+                dataspace, H5S_SELECT_SET, start_dims, stride_dims, count_dims, nullptr
+            );
+            if (status < 0) {
+                throw h5::exception("failed to select hyperslab");
+            }
+
+            return dataspace;
+        }
+
+
+        // Selects row blocks, given as (start, count) pairs in ascending
+        // order, in a copy of `dataspace`.
+        template<int rank>
+        h5::unique_hid<H5Sclose> select_row_blocks(
+            hid_t dataspace,
+            std::pair<hsize_t, hsize_t> const* blocks,
+            std::size_t block_count
+        )
+        {
+            h5::unique_hid<H5Sclose> selection = H5Scopy(dataspace);
+            if (selection < 0) {
+                throw h5::exception("failed to copy dataspace");
+            }
+
+            hsize_t start[rank] = {};
+            hsize_t count[rank];
+            if (H5Sget_simple_extent_dims(dataspace, count, nullptr) != rank) {
+                throw h5::exception("unexpected dataset rank");
+            }
+
+            if (block_count == 0) {
+                if (H5Sselect_none(selection) < 0) {
+                    throw h5::exception("failed to reset selection");
+                }
+                return selection;
+            }
+
+#if H5_VERSION_GE(1, 10, 6)
+            // OR-ing blocks one by one takes quadratic time. Merge selections
+            // pairwise instead.
+            if (block_count > 1) {
+                auto const half = block_count / 2;
+                auto const left = select_row_blocks<rank>(dataspace, blocks, half);
+                auto const right = select_row_blocks<rank>(
+                    dataspace, blocks + half, block_count - half
+                );
+                selection = H5Scombine_select(left, H5S_SELECT_OR, right);
+                if (selection < 0) {
+                    throw h5::exception("failed to select rows");
+                }
+                return selection;
+            }
+#endif
+
+            for (std::size_t i = 0; i < block_count; i++) {
+                start[0] = blocks[i].first;
+                count[0] = blocks[i].second;
+
+                auto const op = (i == 0 ? H5S_SELECT_SET : H5S_SELECT_OR);
+                auto const status = H5Sselect_hyperslab(
+                    selection, op, start, nullptr, count, nullptr
+                );
+                if (status < 0) {
+                    throw h5::exception("failed to select rows");
+                }
+            }
+
+            return selection;
+        }
+
+
+        // Creates a dataspace for a memory buffer of given shape.
+        template<int rank>
+        h5::unique_hid<H5Sclose> create_memspace(h5::shape<rank> const& shape)
+        {
+            hsize_t dims[rank];
+            detail::set_dims(shape, dims);
+
+            h5::unique_hid<H5Sclose> memspace = H5Screate_simple(rank, dims, nullptr);
+            if (memspace < 0) {
+                throw h5::exception("failed to create dataspace");
+            }
+            return memspace;
+        }
+
+
+        // Retrieves the chunk dimensions of `dataset`. Returns false if the
+        // dataset is not chunked.
+        inline bool get_chunk_dims(hid_t dataset, int rank, hsize_t* dims)
+        {
+            h5::unique_hid<H5Pclose> dataset_props = H5Dget_create_plist(dataset);
+            if (dataset_props < 0) {
+                throw h5::exception("failed to get dataset props");
+            }
+
+            if (H5Pget_layout(dataset_props) != H5D_CHUNKED) {
+                return false;
+            }
+
+            if (H5Pget_chunk(dataset_props, rank, dims) != rank) {
+                throw h5::exception("failed to get chunk size");
+            }
+            return true;
+        }
+
+
+        // Checks if `dataset` is a chunked dataset with unlimited first
+        // dimension that stores records of given shape. Throws an exception
+        // if not.
+        template<int record_rank>
+        void check_unlimited_dataset(
+            hid_t dataset, h5::shape<record_rank> const& record_shape
+        )
+        {
+            constexpr int data_rank = record_rank + 1;
+
+            hsize_t chunk_dims[data_rank];
+            if (!detail::get_chunk_dims(dataset, data_rank, chunk_dims)) {
+                throw h5::exception("dataset is not chunked");
+            }
+
+            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
+            if (dataspace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+
+            hsize_t dims[data_rank];
+            hsize_t max_dims[data_rank];
+            if (H5Sget_simple_extent_dims(dataspace, dims, max_dims) != data_rank) {
+                throw h5::exception("failed to determine dataset shape");
+            }
+
+            if (max_dims[0] != H5S_UNLIMITED) {
+                throw h5::exception("dataset is not unlimited");
+            }
+
+            hsize_t record_dims[data_rank];
+            detail::set_dims(record_shape, record_dims);
+            for (int i = 0; i < record_rank; i++) {
+                if (dims[i + 1] != record_dims[i]) {
+                    throw h5::exception("record shape mismatch");
+                }
+            }
+        }
+
+
+        // Records staged in memory by a buffered `stream_writer`.
+        struct stream_staging
+        {
+            std::vector<unsigned char> data;
+            hid_t type = -1;
+            std::size_t count = 0;
+        };
+
+
+        // Returns the mutex serializing HDF5 calls made by background
+        // threads. libhdf5 is not thread-safe unless built so.
+        inline std::mutex& library_mutex()
+        {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+
+        // Fixed-size pool of worker threads running submitted tasks.
+        class worker_pool
+        {
+        public:
+            // Starts `threads` worker threads. Zero uses the number of
+            // hardware threads.
+            explicit worker_pool(unsigned threads)
+            {
+                if (threads == 0) {
+                    threads = std::max(1u, std::thread::hardware_concurrency());
+                }
+                for (unsigned i = 0; i < threads; i++) {
+                    _threads.emplace_back([this] { run(); });
+                }
+            }
+
+            // Destructor discards queued tasks and waits for running ones.
+            ~worker_pool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock{_mutex};
+                    _stopping = true;
+                    _tasks.clear();
+                }
+                _wakeup.notify_all();
+
+                for (auto& thread : _threads) {
+                    thread.join();
+                }
+            }
+
+            worker_pool(worker_pool const&) = delete;
+            worker_pool& operator=(worker_pool const&) = delete;
+
+            // Returns the number of worker threads.
+            std::size_t size() const noexcept
+            {
+                return _threads.size();
+            }
+
+            // Queues a task. The returned future receives the result or the
+            // exception thrown by the task.
+            template<typename F>
+            std::future<typename std::result_of<F()>::type> submit(F fn)
+            {
+                using result_type = typename std::result_of<F()>::type;
+
+                auto task = std::make_shared<std::packaged_task<result_type()>>(std::move(fn));
+                auto future = task->get_future();
+                {
+                    std::lock_guard<std::mutex> lock{_mutex};
+                    _tasks.emplace_back([task] { (*task)(); });
+                }
+                _wakeup.notify_one();
+
+                return future;
+            }
+
+        private:
+            void run()
+            {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock{_mutex};
+                        _wakeup.wait(lock, [&] { return _stopping || !_tasks.empty(); });
+                        if (_stopping) {
+                            break;
+                        }
+                        task = std::move(_tasks.front());
+                        _tasks.pop_front();
+                    }
+                    task();
+                }
+            }
+
+        private:
+            std::deque<std::function<void()>> _tasks;
+            bool _stopping = false;
+            std::mutex _mutex;
+            std::condition_variable _wakeup;
+            std::vector<std::thread> _threads;
+        };
+
+
+        // Filters this library can apply to chunks by itself.
+        struct chunk_filters
+        {
+            bool shuffle = false;
+            int deflate = -1;
+        };
+
+
+        // Determines the filters configured in dataset creation props.
+        // Returns false if a filter is not supported by `encode_chunk`.
+        inline bool get_chunk_filters(hid_t dataset_props, detail::chunk_filters& filters)
+        {
+            auto const filter_count = H5Pget_nfilters(dataset_props);
+            if (filter_count < 0) {
+                throw h5::exception("failed to get filters");
+            }
+
+            filters = {};
+
+            for (unsigned i = 0; i < static_cast<unsigned>(filter_count); i++) {
+                unsigned flags;
+                unsigned values[8];
+                std::size_t value_count = 8;
+
+                auto const filter = H5Pget_filter2(
+                    dataset_props, i, &flags, &value_count, values, 0, nullptr, nullptr
+                );
+
+                // Shuffle must precede deflate just like the props we create.
+                if (filter == H5Z_FILTER_SHUFFLE && !filters.shuffle && filters.deflate < 0) {
+                    filters.shuffle = true;
+                    continue;
+                }
+#ifdef SNSINFU_H5_USE_ZLIB
+                if (filter == H5Z_FILTER_DEFLATE && filters.deflate < 0 && value_count > 0) {
+                    filters.deflate = static_cast<int>(values[0]);
+                    continue;
+                }
+#endif
+                return false;
+            }
+
+            return true;
+        }
+
+
+        // Iterates over rows (runs along the last axis) of the region of a
+        // chunk that lies inside a dataset of shape `dims`. Calls
+        // `fn(array_index, chunk_index, length)` with element indices into
+        // the flattened array and the flattened chunk.
+        template<typename F>
+        void for_each_chunk_row(
+            int rank,
+            hsize_t const* dims,
+            hsize_t const* chunk_dims,
+            hsize_t const* offset,
+            F fn
+        )
+        {
+            hsize_t extent[H5S_MAX_RANK];
+            for (int i = 0; i < rank; i++) {
+                extent[i] = std::min(chunk_dims[i], dims[i] - offset[i]);
+            }
+
+            auto const last = rank - 1;
+            hsize_t index[H5S_MAX_RANK] = {};
+
+            for (;;) {
+                hsize_t array_index = 0;
+                hsize_t chunk_index = 0;
+                for (int i = 0; i < rank; i++) {
+                    array_index = array_index * dims[i] + offset[i] + index[i];
+                    chunk_index = chunk_index * chunk_dims[i] + index[i];
+                }
+                fn(
+                    static_cast<std::size_t>(array_index),
+                    static_cast<std::size_t>(chunk_index),
+                    static_cast<std::size_t>(extent[last])
+                );
+
+                int axis = last - 1;
+                for (; axis >= 0; axis--) {
+                    if (++index[axis] < extent[axis]) {
+                        break;
+                    }
+                    index[axis] = 0;
+                }
+                if (axis < 0) {
+                    break;
+                }
+            }
+        }
+
+
+        // Computes the offset of the `index`-th chunk in row-major order.
+        inline void get_chunk_offset(
+            int rank,
+            hsize_t const* dims,
+            hsize_t const* chunk_dims,
+            std::size_t index,
+            hsize_t* offset
+        )
+        {
+            for (int i = rank - 1; i >= 0; i--) {
+                auto const grid = (dims[i] + chunk_dims[i] - 1) / chunk_dims[i];
+                offset[i] = (index % grid) * chunk_dims[i];
+                index = static_cast<std::size_t>(index / grid);
+            }
+        }
+
+
+        // Returns the number of chunks covering a dataset.
+        inline std::size_t count_chunks(int rank, hsize_t const* dims, hsize_t const* chunk_dims)
+        {
+            std::size_t count = 1;
+            for (int i = 0; i < rank; i++) {
+                count *= static_cast<std::size_t>((dims[i] + chunk_dims[i] - 1) / chunk_dims[i]);
+            }
+            return count;
+        }
+
+
+        // Reorders bytes of `count` values of given size so that the k-th
+        // bytes of all values are adjacent. This is the shuffle filter.
+        inline void shuffle_bytes(
+            unsigned char const* src, unsigned char* dst, std::size_t count, std::size_t size
+        )
+        {
+            for (std::size_t i = 0; i < count; i++) {
+                for (std::size_t k = 0; k < size; k++) {
+                    dst[k * count + i] = src[i * size + k];
+                }
+            }
+        }
+
+
+        // Reverts `shuffle_bytes`.
+        inline void unshuffle_bytes(
+            unsigned char const* src, unsigned char* dst, std::size_t count, std::size_t size
+        )
+        {
+            for (std::size_t i = 0; i < count; i++) {
+                for (std::size_t k = 0; k < size; k++) {
+                    dst[i * size + k] = src[k * count + i];
+                }
+            }
+        }
+
+
+        // Applies filters to raw chunk bytes holding values of given size.
+        // The result is byte-compatible with the HDF5 filter pipeline.
+        inline std::vector<unsigned char> encode_chunk(
+            detail::chunk_filters const& filters,
+            std::size_t value_size,
+            std::vector<unsigned char> data
+        )
+        {
+            if (filters.shuffle && value_size > 1) {
+                std::vector<unsigned char> shuffled(data.size());
+                detail::shuffle_bytes(
+                    data.data(), shuffled.data(), data.size() / value_size, value_size
+                );
+                data.swap(shuffled);
+            }
+
+#ifdef SNSINFU_H5_USE_ZLIB
+            if (filters.deflate >= 0) {
+                auto size = compressBound(static_cast<uLong>(data.size()));
+                std::vector<unsigned char> compressed(size);
+
+                auto const status = compress2(
+                    compressed.data(),
+                    &size,
+                    data.data(),
+                    static_cast<uLong>(data.size()),
+                    filters.deflate
+                );
+                if (status != Z_OK) {
+                    throw h5::exception("failed to compress chunk");
+                }
+                compressed.resize(size);
+                data.swap(compressed);
+            }
+#endif
+
+            return data;
+        }
+
+
+        // Reverts `encode_chunk`. Returns false if the chunk does not decode
+        // to `size` bytes.
+        inline bool decode_chunk(
+            detail::chunk_filters const& filters,
+            std::size_t value_size,
+            std::vector<unsigned char>& data,
+            std::size_t size
+        )
+        {
+#ifdef SNSINFU_H5_USE_ZLIB
+            if (filters.deflate >= 0) {
+                std::vector<unsigned char> decompressed(size);
+                auto decompressed_size = static_cast<uLongf>(size);
+
+                auto const status = uncompress(
+                    decompressed.data(),
+                    &decompressed_size,
+                    data.data(),
+                    static_cast<uLong>(data.size())
+                );
+                if (status != Z_OK) {
+                    throw h5::exception("failed to decompress chunk");
+                }
+                decompressed.resize(decompressed_size);
+                data.swap(decompressed);
+            }
+#endif
+
+            if (data.size() != size) {
+                return false;
+            }
+
+            if (filters.shuffle && value_size > 1) {
+                std::vector<unsigned char> unshuffled(data.size());
+                detail::unshuffle_bytes(
+                    data.data(), unshuffled.data(), data.size() / value_size, value_size
+                );
+                data.swap(unshuffled);
+            }
+
+            return true;
+        }
+
+
+        // Writes a whole simple dataset chunk by chunk, filtering the chunks
+        // on a pool of threads and committing them with `H5Dwrite_chunk`.
+        //
+        // Returns false without writing anything if the dataset is not
+        // chunked or uses a filter `encode_chunk` does not support. The
+        // caller should fall back to `H5Dwrite` then.
+        //
+        template<typename T>
+        bool write_chunks_parallel(hid_t dataset, T const* buf, unsigned threads)
+        {
+#if H5_VERSION_GE(1, 10, 3)
+            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
+            if (dataspace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+
+            auto const rank = H5Sget_simple_extent_ndims(dataspace);
+            if (rank <= 0) {
+                return false;
+            }
+
+            hsize_t dims[H5S_MAX_RANK];
+            if (H5Sget_simple_extent_dims(dataspace, dims, nullptr) != rank) {
+                throw h5::exception("failed to determine dataset shape");
+            }
+
+            hsize_t chunk_dims[H5S_MAX_RANK];
+            if (!detail::get_chunk_dims(dataset, rank, chunk_dims)) {
+                return false;
+            }
+
+            h5::unique_hid<H5Pclose> dataset_props = H5Dget_create_plist(dataset);
+            if (dataset_props < 0) {
+                throw h5::exception("failed to get dataset props");
+            }
+
+            detail::chunk_filters filters;
+            if (!detail::get_chunk_filters(dataset_props, filters)) {
+                return false;
+            }
+
+            h5::unique_hid<H5Tclose> storage_type = H5Dget_type(dataset);
+            if (storage_type < 0) {
+                throw h5::exception("failed to determine dataset type");
+            }
+
+            hid_t const memory_type = h5::memory_type<T>();
+            hid_t const file_type = storage_type;
+            auto const value_size = H5Tget_size(storage_type);
+            auto const convert = H5Tequal(memory_type, storage_type) <= 0;
+
+            std::size_t chunk_size = 1;
+            for (int i = 0; i < rank; i++) {
+                chunk_size *= static_cast<std::size_t>(chunk_dims[i]);
+            }
+
+            // Filters each chunk in a task. Edge chunks are padded with
+            // zeros since HDF5 always stores full chunks.
+            auto encode = [&](std::size_t index) {
+                hsize_t offset[H5S_MAX_RANK];
+                detail::get_chunk_offset(rank, dims, chunk_dims, index, offset);
+
+                std::vector<unsigned char> data(chunk_size * std::max(sizeof(T), value_size));
+                auto const values = reinterpret_cast<T*>(data.data());
+
+                detail::for_each_chunk_row(
+                    rank, dims, chunk_dims, offset,
+                    [&](std::size_t array_index, std::size_t chunk_index, std::size_t length) {
+                        std::copy_n(buf + array_index, length, values + chunk_index);
+                    }
+                );
+
+                if (convert) {
+                    std::lock_guard<std::mutex> library_lock{detail::library_mutex()};
+                    auto const status = H5Tconvert(
+                        memory_type, file_type, chunk_size, data.data(), nullptr, H5P_DEFAULT
+                    );
+                    if (status < 0) {
+                        H5Eclear2(H5E_DEFAULT);
+                        throw h5::exception("failed to convert values");
+                    }
+                }
+                data.resize(chunk_size * value_size);
+
+                return detail::encode_chunk(filters, value_size, std::move(data));
+            };
+
+            // Commit chunks in order on this thread while at most a few
+            // chunks per worker are in flight.
+            detail::worker_pool pool{threads};
+            std::deque<std::future<std::vector<unsigned char>>> pending;
+
+            auto const chunk_count = detail::count_chunks(rank, dims, chunk_dims);
+            auto const max_pending = 2 * pool.size();
+            std::size_t next = 0;
+
+            for (std::size_t index = 0; index < chunk_count; index++) {
+                while (next < chunk_count && pending.size() < max_pending) {
+                    pending.push_back(pool.submit([&encode, next] { return encode(next); }));
+                    next++;
+                }
+
+                auto const chunk = pending.front().get();
+                pending.pop_front();
+
+                hsize_t offset[H5S_MAX_RANK];
+                detail::get_chunk_offset(rank, dims, chunk_dims, index, offset);
+
+                std::lock_guard<std::mutex> library_lock{detail::library_mutex()};
+                auto const status = H5Dwrite_chunk(
+                    dataset, H5P_DEFAULT, 0, offset, chunk.size(), chunk.data()
+                );
+                if (status < 0) {
+                    throw h5::exception("failed to write chunk");
+                }
+            }
+
+            return true;
+#else
+            (void) dataset;
+            (void) buf;
+            (void) threads;
+            return false;
+#endif
+        }
+
+        template<>
+        inline bool write_chunks_parallel<std::string>(
+            hid_t, std::string const*, unsigned
+        )
+        {
+            return false;
+        }
+
+
+        // Reads a whole simple dataset chunk by chunk. Raw chunks are read
+        // with `H5Dread_chunk` on the calling thread, and unfiltered and
+        // scattered into `buf` on a pool of threads.
+        //
+        // Returns false without reading anything if the dataset is not
+        // chunked, some chunks are not allocated, the dataset uses a filter
+        // `decode_chunk` does not support, or the dataset type differs from
+        // `T`. The caller should fall back to `H5Dread` then.
+        //
+        template<typename T>
+        bool read_chunks_parallel(hid_t dataset, T* buf, unsigned threads)
+        {
+#if H5_VERSION_GE(1, 10, 5)
+            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
+            if (dataspace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+
+            auto const rank = H5Sget_simple_extent_ndims(dataspace);
+            if (rank <= 0) {
+                return false;
+            }
+
+            hsize_t dims[H5S_MAX_RANK];
+            if (H5Sget_simple_extent_dims(dataspace, dims, nullptr) != rank) {
+                throw h5::exception("failed to determine dataset shape");
+            }
+
+            hsize_t chunk_dims[H5S_MAX_RANK];
+            if (!detail::get_chunk_dims(dataset, rank, chunk_dims)) {
+                return false;
+            }
+
+            auto const chunk_count = detail::count_chunks(rank, dims, chunk_dims);
+
+            hsize_t allocated_count;
+            if (H5Dget_num_chunks(dataset, dataspace, &allocated_count) < 0) {
+                throw h5::exception("failed to count chunks");
+            }
+            if (allocated_count != chunk_count) {
+                return false;
+            }
+
+            h5::unique_hid<H5Pclose> dataset_props = H5Dget_create_plist(dataset);
+            if (dataset_props < 0) {
+                throw h5::exception("failed to get dataset props");
+            }
+
+            detail::chunk_filters filters;
+            if (!detail::get_chunk_filters(dataset_props, filters)) {
+                return false;
+            }
+
+            h5::unique_hid<H5Tclose> storage_type = H5Dget_type(dataset);
+            if (storage_type < 0) {
+                throw h5::exception("failed to determine dataset type");
+            }
+            if (H5Tequal(h5::memory_type<T>(), storage_type) <= 0) {
+                return false;
+            }
+
+            std::size_t chunk_size = 1;
+            for (int i = 0; i < rank; i++) {
+                chunk_size *= static_cast<std::size_t>(chunk_dims[i]);
+            }
+
+            // Unfilters a raw chunk and scatters its values in a task.
+            // Returns false if the chunk could not be decoded.
+            auto decode = [&](std::size_t index, std::vector<unsigned char>& data) {
+                if (!detail::decode_chunk(filters, sizeof(T), data, chunk_size * sizeof(T))) {
+                    return false;
+                }
+
+                hsize_t offset[H5S_MAX_RANK];
+                detail::get_chunk_offset(rank, dims, chunk_dims, index, offset);
+
+                auto const values = reinterpret_cast<T const*>(data.data());
+                detail::for_each_chunk_row(
+                    rank, dims, chunk_dims, offset,
+                    [&](std::size_t array_index, std::size_t chunk_index, std::size_t length) {
+                        std::copy_n(values + chunk_index, length, buf + array_index);
+                    }
+                );
+                return true;
+            };
+
+            // Reads the chunk through the filter pipeline. Used for chunks
+            // HDF5 stored with some filters skipped.
+            auto read_chunk = [&](std::size_t index) {
+                hsize_t offset[H5S_MAX_RANK];
+                hsize_t count[H5S_MAX_RANK];
+                detail::get_chunk_offset(rank, dims, chunk_dims, index, offset);
+                for (int i = 0; i < rank; i++) {
+                    count[i] = std::min(chunk_dims[i], dims[i] - offset[i]);
+                }
+
+                h5::unique_hid<H5Sclose> memspace = H5Scopy(dataspace);
+                h5::unique_hid<H5Sclose> filespace = H5Scopy(dataspace);
+                if (memspace < 0 || filespace < 0) {
+                    throw h5::exception("failed to copy dataspace");
+                }
+                for (hid_t space : {hid_t(memspace), hid_t(filespace)}) {
+                    auto const status = H5Sselect_hyperslab(
+                        space, H5S_SELECT_SET, offset, nullptr, count, nullptr
+                    );
+                    if (status < 0) {
+                        throw h5::exception("failed to select chunk");
+                    }
+                }
+
+                std::lock_guard<std::mutex> library_lock{detail::library_mutex()};
+                detail::read_dataset(dataset, buf, 0, memspace, filespace);
+            };
+
+            detail::worker_pool pool{threads};
+            std::deque<std::pair<std::size_t, std::future<bool>>> pending;
+            auto const max_pending = 2 * pool.size();
+
+            auto finish_one = [&] {
+                auto const index = pending.front().first;
+                auto const decoded = pending.front().second.get();
+                pending.pop_front();
+                if (!decoded) {
+                    read_chunk(index);
+                }
+            };
+
+            for (std::size_t index = 0; index < chunk_count; index++) {
+                if (pending.size() == max_pending) {
+                    finish_one();
+                }
+
+                hsize_t offset[H5S_MAX_RANK];
+                detail::get_chunk_offset(rank, dims, chunk_dims, index, offset);
+
+                auto data = std::make_shared<std::vector<unsigned char>>();
+                std::uint32_t filter_mask = 0;
+                {
+                    std::lock_guard<std::mutex> library_lock{detail::library_mutex()};
+
+                    hsize_t size;
+                    if (H5Dget_chunk_storage_size(dataset, offset, &size) < 0) {
+                        throw h5::exception("failed to get chunk size");
+                    }
+                    data->resize(static_cast<std::size_t>(size));
+
+                    auto const status = H5Dread_chunk(
+                        dataset, H5P_DEFAULT, offset, &filter_mask, data->data()
+                    );
+                    if (status < 0) {
+                        throw h5::exception("failed to read chunk");
+                    }
+                }
+
+                if (filter_mask != 0) {
+                    read_chunk(index);
+                    continue;
+                }
+
+                pending.emplace_back(
+                    index, pool.submit([&decode, index, data] { return decode(index, *data); })
+                );
+            }
+
+            while (!pending.empty()) {
+                finish_one();
+            }
+
+            return true;
+#else
+            (void) dataset;
+            (void) buf;
+            (void) threads;
+            return false;
+#endif
+        }
+
+        template<>
+        inline bool read_chunks_parallel<std::string>(
+            hid_t, std::string*, unsigned
+        )
+        {
+            return false;
+        }
+
+
+        // Returns the name of the attribute recording the number of records
+        // in a dataset whose extent a buffered stream has grown ahead of
+        // the records. The attribute is removed when the extent is trimmed,
+        // so it remains only if the writing process is killed.
+        inline char const* stream_size_attribute()
+        {
+            return ".stream_size";
+        }
+
+
+        // Records the number of valid records in an over-allocated dataset.
+        inline void store_stream_size(hid_t dataset, hsize_t size)
+        {
+            auto const name = detail::stream_size_attribute();
+            std::uint64_t const value = size;
+
+            h5::unique_hid<H5Aclose> attribute;
+            auto const exists = H5Aexists(dataset, name);
+            if (exists < 0) {
+                throw h5::exception("failed to check stream size attribute");
+            }
+            if (exists > 0) {
+                attribute = H5Aopen(dataset, name, H5P_DEFAULT);
+            } else {
+                h5::unique_hid<H5Sclose> dataspace = H5Screate(H5S_SCALAR);
+                if (dataspace < 0) {
+                    throw h5::exception("failed to create dataspace");
+                }
+                attribute = H5Acreate2(
+                    dataset, name, H5T_STD_U64LE, dataspace, H5P_DEFAULT, H5P_DEFAULT
+                );
+            }
+            if (attribute < 0) {
+                throw h5::exception("failed to open stream size attribute");
+            }
+
+            if (H5Awrite(attribute, H5T_NATIVE_UINT64, &value) < 0) {
+                throw h5::exception("failed to write stream size attribute");
+            }
+        }
+
+
+        // Reads the number of valid records recorded by `store_stream_size`.
+        // Returns false if the dataset has no record.
+        inline bool load_stream_size(hid_t dataset, hsize_t& size)
+        {
+            auto const name = detail::stream_size_attribute();
+
+            auto const exists = H5Aexists(dataset, name);
+            if (exists < 0) {
+                throw h5::exception("failed to check stream size attribute");
+            }
+            if (exists == 0) {
+                return false;
+            }
+
+            h5::unique_hid<H5Aclose> attribute = H5Aopen(dataset, name, H5P_DEFAULT);
+            if (attribute < 0) {
+                throw h5::exception("failed to open stream size attribute");
+            }
+
+            std::uint64_t value;
+            if (H5Aread(attribute, H5T_NATIVE_UINT64, &value) < 0) {
+                throw h5::exception("failed to read stream size attribute");
+            }
+            size = static_cast<hsize_t>(value);
+
+            return true;
+        }
+
+
+        // Removes the record stored by `store_stream_size`, if any.
+        inline void remove_stream_size(hid_t dataset)
+        {
+            auto const name = detail::stream_size_attribute();
+
+            auto const exists = H5Aexists(dataset, name);
+            if (exists < 0) {
+                throw h5::exception("failed to check stream size attribute");
+            }
+            if (exists > 0 && H5Adelete(dataset, name) < 0) {
+                throw h5::exception("failed to delete stream size attribute");
+            }
+        }
+
+
+        // Appends records to the end of an unlimited dataset.
+        template<int data_rank>
+        class stream_sink
+        {
+        public:
+            // Parameters:
+            //   dataset     = The dataset to write to.
+            //   record_dims = Dimensions of each record.
+            //   growth      = Minimum number of records to extend the
+            //                 dataset at once. Zero disables geometric
+            //                 growth and keeps the extent exact.
+            //
+            // Records are appended after the current extent of the dataset.
+            // If a buffered stream writing to the dataset was killed before
+            // trimming it, the dataset is first trimmed to the records the
+            // stream had written out.
+            //
+            stream_sink(hid_t dataset, hsize_t const* record_dims, std::size_t growth)
+                : _dataset{dataset}, _growth{growth}
+            {
+                _dataspace = H5Dget_space(dataset);
+                if (_dataspace < 0) {
+                    throw h5::exception("failed to determine dataspace");
+                }
+
+                if (H5Sget_simple_extent_dims(_dataspace, _datadims, nullptr) != data_rank) {
+                    throw h5::exception("failed to determine dataset shape");
+                }
+
+                _maxdims[0] = H5S_UNLIMITED;
+                _memdims[0] = 1;
+                std::copy(record_dims, record_dims + data_rank - 1, _maxdims + 1);
+                std::copy(record_dims, record_dims + data_rank - 1, _datadims + 1);
+                std::copy(record_dims, record_dims + data_rank - 1, _memdims + 1);
+
+                _offset[0] = _datadims[0];
+                _capacity = _datadims[0];
+
+                hsize_t size;
+                if (detail::load_stream_size(dataset, size)) {
+                    _datadims[0] = std::min(size, _capacity);
+                    _offset[0] = _datadims[0];
+                    if (_capacity != _datadims[0]) {
+                        resize(_datadims[0]);
+                    }
+                    detail::remove_stream_size(dataset);
+                }
+
+                for (int i = 1; i < data_rank; i++) {
+                    _record_size *= static_cast<std::size_t>(_datadims[i]);
+                }
+
+                _memspace = H5Screate_simple(data_rank, _memdims, nullptr);
+                if (_memspace < 0) {
+                    throw h5::exception("failed to create dataspace");
+                }
+            }
+
+            // Makes `append` write whole chunks directly with
+            // `H5Dwrite_chunk`, filtering them by this library instead of
+            // the HDF5 filter pipeline. Does nothing if the dataset uses a
+            // filter `encode_chunk` does not support.
+            void enable_direct_chunks()
+            {
+#if H5_VERSION_GE(1, 10, 3)
+                h5::unique_hid<H5Pclose> dataset_props = H5Dget_create_plist(_dataset);
+                if (dataset_props < 0) {
+                    throw h5::exception("failed to get dataset props");
+                }
+                if (!detail::get_chunk_filters(dataset_props, _filters)) {
+                    return;
+                }
+                if (!detail::get_chunk_dims(_dataset, data_rank, _chunk_dims)) {
+                    return;
+                }
+
+                _storage_type = H5Dget_type(_dataset);
+                if (_storage_type < 0) {
+                    throw h5::exception("failed to determine dataset type");
+                }
+
+                auto const type_class = H5Tget_class(_storage_type);
+                _direct = (type_class == H5T_INTEGER || type_class == H5T_FLOAT);
+#endif
+            }
+
+            // Writes `count` records to the end of the dataset. Whole chunks
+            // are written directly if enabled. Other records are written in
+            // a single hyperslab.
+            void append(hid_t type, void const* buf, std::size_t count)
+            {
+                auto const end = _datadims[0] + count;
+                if (end > _capacity) {
+                    reserve(end);
+                }
+
+                auto const type_class = H5Tget_class(type);
+                if (!_direct || (type_class != H5T_INTEGER && type_class != H5T_FLOAT)) {
+                    write_hyperslab(type, buf, count);
+                } else {
+                    write_direct(type, buf, count);
+                }
+            }
+
+            // Returns the number of written records.
+            std::size_t size() const noexcept
+            {
+                return static_cast<std::size_t>(_datadims[0]);
+            }
+
+            // Shrinks the dataset to the exact number of written records.
+            void trim()
+            {
+                if (_capacity != _datadims[0]) {
+                    resize(_datadims[0]);
+                    detail::remove_stream_size(_dataset);
+                }
+            }
+
+        private:
+            // Writes whole chunks directly and other records in hyperslabs.
+            void write_direct(hid_t type, void const* buf, std::size_t count)
+            {
+                auto const records = static_cast<unsigned char const*>(buf);
+                auto const record_bytes = H5Tget_size(type) * _record_size;
+                auto const chunk_records = static_cast<std::size_t>(_chunk_dims[0]);
+
+                // Records before the next chunk boundary.
+                auto const misalignment = static_cast<std::size_t>(_offset[0] % _chunk_dims[0]);
+                auto const head = std::min(count, (chunk_records - misalignment) % chunk_records);
+                if (head > 0) {
+                    write_hyperslab(type, records, head);
+                }
+
+                auto const body = (count - head) / chunk_records * chunk_records;
+                if (body > 0) {
+                    write_chunks(type, records + head * record_bytes, body);
+                }
+
+                auto const tail = count - head - body;
+                if (tail > 0) {
+                    write_hyperslab(type, records + (head + body) * record_bytes, tail);
+                }
+            }
+
+            // Writes `count` records in a single hyperslab to the end of the
+            // dataset. The dataset must have enough capacity.
+            void write_hyperslab(hid_t type, void const* buf, std::size_t count)
+            {
+                herr_t status;
+
+                auto const end = _datadims[0] + count;
+
+                _memdims[0] = count;
+                status = H5Sset_extent_simple(_memspace, data_rank, _memdims, nullptr);
+                if (status < 0) {
+                    throw h5::exception("failed to resize memory dataspace");
+                }
+
+                status = H5Sselect_hyperslab(
+                    _dataspace, H5S_SELECT_SET, _offset, nullptr, _memdims, nullptr
+                );
+                if (status < 0) {
+                    throw h5::exception("failed to select hyperslab for streaming write");
+                }
+
+                status = H5Dwrite(_dataset, type, _memspace, _dataspace, H5P_DEFAULT, buf);
+                if (status < 0) {
+                    throw h5::exception("failed to write to dataset");
+                }
+
+                _datadims[0] = end;
+                _offset[0] = _datadims[0];
+            }
+
+            // Filters and writes whole rows of chunks to the end of the
+            // dataset. `count` must be a multiple of the chunk length and the
+            // end must be at a chunk boundary.
+            void write_chunks(hid_t type, unsigned char const* buf, std::size_t count)
+            {
+#if H5_VERSION_GE(1, 10, 3)
+                hsize_t dims[data_rank];
+                std::copy(_datadims, _datadims + data_rank, dims);
+                dims[0] = count;
+
+                auto const type_size = H5Tget_size(type);
+                auto const value_size = H5Tget_size(_storage_type);
+                auto const convert = H5Tequal(type, _storage_type) <= 0;
+
+                std::size_t chunk_size = 1;
+                for (int i = 0; i < data_rank; i++) {
+                    chunk_size *= static_cast<std::size_t>(_chunk_dims[i]);
+                }
+
+                auto const chunk_count = detail::count_chunks(data_rank, dims, _chunk_dims);
+
+                for (std::size_t index = 0; index < chunk_count; index++) {
+                    hsize_t offset[data_rank];
+                    detail::get_chunk_offset(data_rank, dims, _chunk_dims, index, offset);
+
+                    // Edge chunks along record axes are padded with zeros.
+                    std::vector<unsigned char> data(chunk_size * std::max(type_size, value_size));
+                    detail::for_each_chunk_row(
+                        data_rank, dims, _chunk_dims, offset,
+                        [&](std::size_t array_index, std::size_t chunk_index, std::size_t length) {
+                            std::memcpy(
+                                data.data() + chunk_index * type_size,
+                                buf + array_index * type_size,
+                                length * type_size
+                            );
+                        }
+                    );
+
+                    if (convert) {
+                        auto const status = H5Tconvert(
+                            type, _storage_type, chunk_size, data.data(), nullptr, H5P_DEFAULT
+                        );
+                        if (status < 0) {
+                            throw h5::exception("failed to convert values");
+                        }
+                    }
+                    data.resize(chunk_size * value_size);
+
+                    auto const chunk = detail::encode_chunk(_filters, value_size, std::move(data));
+
+                    offset[0] += _offset[0];
+                    auto const status = H5Dwrite_chunk(
+                        _dataset, H5P_DEFAULT, 0, offset, chunk.size(), chunk.data()
+                    );
+                    if (status < 0) {
+                        throw h5::exception("failed to write chunk");
+                    }
+                }
+
+                _datadims[0] += count;
+                _offset[0] = _datadims[0];
+#else
+                write_hyperslab(type, buf, count);
+#endif
+            }
+
+            // Extends the dataset to hold at least `size` records.
+            void reserve(hsize_t size)
+            {
+                auto capacity = size;
+                if (_growth > 0) {
+                    capacity = std::max({size, 2 * _capacity, hsize_t(_growth)});
+                }
+
+                // Record the number of valid records before over-allocating
+                // so that a restarted stream does not resume after the
+                // preallocated space. The record is updated only here, not
+                // on every append, so a killed stream loses the records
+                // written since the extent last grew or was trimmed.
+                if (capacity > size) {
+                    detail::store_stream_size(_dataset, _datadims[0]);
+                }
+                resize(capacity);
+            }
+
+            void resize(hsize_t capacity)
+            {
+                hsize_t dims[data_rank];
+                std::copy(_datadims, _datadims + data_rank, dims);
+                dims[0] = capacity;
+
+                if (H5Dset_extent(_dataset, dims) < 0) {
+                    throw h5::exception("failed to extend unlimited dataset");
+                }
+
+                auto const status = H5Sset_extent_simple(_dataspace, data_rank, dims, _maxdims);
+                if (status < 0) {
+                    throw h5::exception("failed to extend dataspace");
+                }
+
+                _capacity = capacity;
+            }
+
+        private:
+            hid_t _dataset;
+            std::size_t _growth;
+            h5::unique_hid<H5Sclose> _dataspace;
+            h5::unique_hid<H5Sclose> _memspace;
+            hsize_t _maxdims[data_rank] = {};
+            hsize_t _datadims[data_rank] = {};
+            hsize_t _memdims[data_rank] = {};
+            hsize_t _offset[data_rank] = {};
+            hsize_t _capacity = 0;
+            std::size_t _record_size = 1;
+            bool _direct = false;
+            detail::chunk_filters _filters;
+            hsize_t _chunk_dims[data_rank] = {};
+            h5::unique_hid<H5Tclose> _storage_type;
+        };
+
+
+        // Background thread draining a bounded ring of staging buffers into
+        // a `stream_sink`.
+        template<int data_rank>
+        class stream_worker
+        {
+        public:
+            stream_worker(stream_sink<data_rank>& sink, std::size_t depth)
+                : _sink{sink}, _free(std::max(depth, std::size_t(1)))
+            {
+                _thread = std::thread{[this] { run(); }};
+            }
+
+            ~stream_worker() noexcept
+            {
+                {
+                    std::lock_guard<std::mutex> lock{_mutex};
+                    _stopping = true;
+                }
+                _wakeup.notify_all();
+                _thread.join();
+            }
+
+            stream_worker(stream_worker const&) = delete;
+            stream_worker& operator=(stream_worker const&) = delete;
+
+            // Queues a staging buffer for writing and replaces it with an
+            // empty buffer from the ring. Blocks while all buffers are in
+            // flight. If the background thread has failed, the staged records
+            // are discarded instead so that the dataset does not get a gap,
+            // and the error is rethrown.
+            void submit(stream_staging& staging)
+            {
+                {
+                    std::unique_lock<std::mutex> lock{_mutex};
+                    _wakeup.wait(lock, [&] { return !_free.empty() || _error; });
+                    if (_error) {
+                        staging.count = 0;
+                        std::rethrow_exception(_error);
+                    }
+                    _queue.push_back(std::move(staging));
+                    staging = std::move(_free.back());
+                    _free.pop_back();
+                }
+                _wakeup.notify_all();
+            }
+
+            // Blocks until all queued buffers are written. Rethrows an error
+            // occurred in the background thread, if any.
+            void wait()
+            {
+                std::unique_lock<std::mutex> lock{_mutex};
+                _wakeup.wait(lock, [&] { return (_queue.empty() && !_busy) || _error; });
+                check_error();
+            }
+
+        private:
+            void run()
+            {
+                std::unique_lock<std::mutex> lock{_mutex};
+
+                for (;;) {
+                    _wakeup.wait(lock, [&] { return !_queue.empty() || _stopping; });
+                    if (_queue.empty()) {
+                        break;
+                    }
+
+                    auto staging = std::move(_queue.front());
+                    _queue.pop_front();
+                    _busy = true;
+                    lock.unlock();
+
+                    std::exception_ptr error;
+                    try {
+                        std::lock_guard<std::mutex> library_lock{library_mutex()};
+                        _sink.append(staging.type, staging.data.data(), staging.count);
+                    } catch (...) {
+                        error = std::current_exception();
+                    }
+                    staging.count = 0;
+
+                    lock.lock();
+                    _busy = false;
+                    _free.push_back(std::move(staging));
+                    if (error && !_error) {
+                        // Records queued after a failure are discarded so
+                        // that the dataset does not get a gap.
+                        _error = error;
+                        for (auto& queued : _queue) {
+                            queued.count = 0;
+                            _free.push_back(std::move(queued));
+                        }
+                        _queue.clear();
+                    }
+                    _wakeup.notify_all();
+                }
+
+                // Thread-safe libhdf5 keeps an error stack per thread, which
+                // is not released when the thread exits.
+                H5Eclear2(H5E_DEFAULT);
+            }
+
+            void check_error()
+            {
+                if (_error) {
+                    std::rethrow_exception(_error);
+                }
+            }
+
+        private:
+            stream_sink<data_rank>& _sink;
+            std::vector<stream_staging> _free;
+            std::deque<stream_staging> _queue;
+            std::exception_ptr _error;
+            bool _busy = false;
+            bool _stopping = false;
+            std::mutex _mutex;
+            std::condition_variable _wakeup;
+            std::thread _thread;
+        };
+    }
+
+
+    // Provides incremental write access to an unliimted HDF5 dataset.
+    //
+    // `stream_writer` incrementally writes arrays of rank `record_rank` to
+    // dataset of rank `record_rank + 1`. The first dimension is assumed to
+    // be unlimited.
+    //
+    // An asynchronous stream writes records on a background thread. libhdf5
+    // is not thread-safe unless built so: in that case the application must
+    // not call HDF5 functions on other threads while the stream has pending
+    // records, i.e., until `flush` returns.
+    //
+    template<typename D, int record_rank>
+    class stream_writer
+    {
+        static constexpr int data_rank = record_rank + 1;
+
+    public:
+        // Constructor initiates writing to the dataset.
+        //
+        // Parameters:
+        //   file         = The file dataset resides in.
+        //   dataset      = The dataset to write to.
+        //   record_shape = Shape of each record (sub-array).
+        //   options      = Streaming options. This parameter is optional.
+        //
+        stream_writer(
+            hid_t file, hid_t dataset, h5::shape<record_rank> const& record_shape
+        )
+            : stream_writer{file, dataset, record_shape, h5::stream_options{}}
+        {
+        }
+
+        stream_writer(
+            hid_t file,
+            hid_t dataset,
+            h5::shape<record_rank> const& record_shape,
+            h5::stream_options const& options
+        )
+            : stream_writer{file, dataset, record_shape, options, nullptr, ""}
+        {
+        }
+
+        // This constructor additionally takes the state of the `h5::file`
+        // the dataset is opened from and the path of the dataset, so that
+        // `flush` follows the flush policy of the file and updates the
+        // catalog.
+        stream_writer(
+            hid_t file,
+            hid_t dataset,
+            h5::shape<record_rank> const& record_shape,
+            h5::stream_options const& options,
+            std::shared_ptr<detail::file_state> state,
+            std::string path
+        )
+            : _file{file}
+            , _record_shape{record_shape}
+            , _state{std::move(state)}
+            , _path{std::move(path)}
+        {
+            hsize_t record_dims[data_rank];
+            detail::set_dims(record_shape, record_dims);
+
+            for (int i = 0; i < record_rank; i++) {
+                _record_size *= static_cast<std::size_t>(record_dims[i]);
+            }
+
+            // Resolve the memory type before starting the background thread.
+            memory_type<D>();
+
+            if (!options.buffered && !options.async && !options.direct_chunk) {
+                _sink = std::make_unique<detail::stream_sink<data_rank>>(
+                    dataset, record_dims, 0
+                );
+                return;
+            }
+
+            // Stage as many records as a chunk holds so that each batch fills
+            // whole chunks.
+            hsize_t chunk_dims[data_rank];
+            if (detail::get_chunk_dims(dataset, data_rank, chunk_dims)) {
+                _batch = static_cast<std::size_t>(chunk_dims[0]);
+            }
+
+            _sink = std::make_unique<detail::stream_sink<data_rank>>(
+                dataset, record_dims, _batch
+            );
+            _staging = std::make_unique<detail::stream_staging>();
+            _position = _sink->size();
+
+            if (options.direct_chunk) {
+                _sink->enable_direct_chunks();
+            }
+
+            if (options.async) {
+                _worker = std::make_unique<detail::stream_worker<data_rank>>(
+                    *_sink, options.queue_depth
+                );
+            }
+        }
+
+        // Destructor writes out staged records and trims the dataset if the
+        // stream is buffered. Errors are silently ignored; call `flush` to
+        // detect them.
+        ~stream_writer() noexcept
+        {
+            close();
+        }
+
+        stream_writer(stream_writer&&) = default;
+
+        // Move assignment finishes the stream being replaced as the
+        // destructor does, and then takes over the other stream.
+        stream_writer& operator=(stream_writer&& other) noexcept
+        {
+            if (this != &other) {
+                close();
+                _worker.reset();
+
+                _file = other._file;
+                _record_shape = other._record_shape;
+                _record_size = other._record_size;
+                _batch = other._batch;
+                _position = other._position;
+                _memory_type = other._memory_type;
+                _memory_type_source = other._memory_type_source;
+                _sink = std::move(other._sink);
+                _staging = std::move(other._staging);
+                _worker = std::move(other._worker);
+                _state = std::move(other._state);
+                _path = std::move(other._path);
+                _written_bytes = other._written_bytes;
+            }
+            return *this;
         }
 
         // Appends a record to the end of the dataset.
         //
         // Parameters:
-        //   T   = Type of the buffer. This must be compatible with the
-        //         dataset type `D`.
-        //   buf = Pointer to the buffer containing flattened record.
+        //   T   = Type of the buffer. This must be compatible with the
+        //         dataset type `D`.
+        //   buf = Pointer to the buffer containing flattened record.
+        //
+        template<typename T>
+        void write(T const* buf)
+        {
+            _written_bytes += _record_size * sizeof(T);
+
+            // Strings are not staged as we would hold the caller's pointers.
+            if (_staging && !std::is_pointer<T>::value) {
+                stage(memory_type<T>(), buf, sizeof(T));
+                return;
+            }
+            drain();
+            wait();
+            _sink->append(memory_type<T>(), buf, 1);
+            _position++;
+        }
+
+        // Calls `write` with buffer's underlying pointer.
+        template<
+            typename Buffer,
+            typename Tr = h5::buffer_traits<Buffer>,
+            typename T = typename Tr::value_type
+        >
+        void write(Buffer const& buffer)
+        {
+            if (Tr::shape(buffer) != _record_shape) {
+                throw h5::exception("buffer has unexpected shape");
+            }
+            write(Tr::data(buffer));
+        }
+
+        // Appends `count` records to the end of the dataset.
+        //
+        // The records are written with a single extent change and a single
+        // `H5Dwrite` call. A buffered stream stages the records instead if
+        // they fit in the staging buffer.
+        //
+        // Parameters:
+        //   T     = Type of the buffer. This must be compatible with the
+        //           dataset type `D`.
+        //   buf   = Pointer to the buffer containing flattened records.
+        //   count = Number of records in the buffer.
+        //
+        template<typename T>
+        void write_n(T const* buf, std::size_t count)
+        {
+            if (count == 0) {
+                return;
+            }
+            _written_bytes += count * _record_size * sizeof(T);
+
+            if (_staging && !std::is_pointer<T>::value) {
+                if (_staging->count + count <= _batch) {
+                    for (std::size_t i = 0; i < count; i++) {
+                        stage(memory_type<T>(), buf + i * _record_size, sizeof(T));
+                    }
+                    return;
+                }
+
+                if (_worker) {
+                    // Hand the whole block to the background thread as an
+                    // oversized batch.
+                    drain();
+                    auto const bytes = count * _record_size * sizeof(T);
+                    _staging->data.resize(std::max(_staging->data.size(), bytes));
+                    std::memcpy(_staging->data.data(), buf, bytes);
+                    _staging->type = memory_type<T>();
+                    _staging->count = count;
+                    drain();
+                    return;
+                }
+            }
+            drain();
+            wait();
+            _sink->append(memory_type<T>(), buf, count);
+            _position += count;
+        }
+
+        // Calls `write_n` with buffer's underlying pointer. The buffer must
+        // be an array of records, i.e., its rank must be `record_rank + 1`.
+        template<
+            typename Buffer,
+            typename Tr = h5::buffer_traits<Buffer>,
+            typename T = typename Tr::value_type
+        >
+        void write_n(Buffer const& buffer)
+        {
+            static_assert(Tr::rank == data_rank, "buffer must be an array of records");
+
+            auto const shape = Tr::shape(buffer);
+            h5::shape<record_rank> record_shape;
+            for (int i = 0; i < record_rank; i++) {
+                record_shape.dims[i] = shape.dims[i + 1];
+            }
+            if (record_shape != _record_shape) {
+                throw h5::exception("buffer has unexpected shape");
+            }
+            write_n(Tr::data(buffer), shape.dims[0]);
+        }
+
+        // Writes out staged records and flushes written data to disk. An
+        // error occurred in the background thread of an asynchronous stream
+        // is rethrown here.
+        //
+        // If the stream originates from an `h5::file`, the records written
+        // since the last `flush` count as a single write and the data is
+        // flushed to disk only if the flush policy of the file says so.
+        //
+        void flush()
+        {
+            drain();
+            wait();
+            _sink->trim();
+
+            detail::notify_write(_state.get(), _file, _path, _written_bytes);
+            _written_bytes = 0;
+        }
+
+    private:
+        // Returns the HDF5 memory type of `T`. `h5::memory_type` enters the
+        // library, so the type is resolved under the library mutex and
+        // remembered. The type of `D` is resolved in the constructor, so
+        // writes of `D` values never call HDF5 on the caller thread while
+        // the background thread is writing.
+        template<typename T>
+        hid_t memory_type()
+        {
+            hid_t (* const source)() = &h5::memory_type<T>;
+            if (_memory_type_source != source) {
+                std::lock_guard<std::mutex> library_lock{detail::library_mutex()};
+                _memory_type = h5::memory_type<T>();
+                _memory_type_source = source;
+            }
+            return _memory_type;
+        }
+
+        // Copies a record to the staging buffer. Staged records are written
+        // when the buffer is full.
+        void stage(hid_t type, void const* buf, std::size_t value_size)
+        {
+            auto& staging = *_staging;
+            auto const record_bytes = _record_size * value_size;
+
+            if (staging.count > 0 && staging.type != type) {
+                drain();
+            }
+            if (staging.data.size() < _batch * record_bytes) {
+                staging.data.resize(_batch * record_bytes);
+            }
+
+            std::memcpy(
+                staging.data.data() + staging.count * record_bytes, buf, record_bytes
+            );
+            staging.type = type;
+            staging.count++;
+
+            // Drain at chunk boundaries so that batches fill whole chunks
+            // even if the stream started in the middle of a chunk.
+            if ((_position + staging.count) % _batch == 0) {
+                drain();
+            }
+        }
+
+        // Writes staged records to the dataset, or hands them over to the
+        // background thread if the stream is asynchronous.
+        void drain()
+        {
+            if (!_staging || _staging->count == 0) {
+                return;
+            }
+
+            auto const count = _staging->count;
+
+            if (_worker) {
+                _worker->submit(*_staging);
+            } else {
+                _sink->append(_staging->type, _staging->data.data(), count);
+                _staging->count = 0;
+            }
+            _position += count;
+        }
+
+        // Waits for the background thread to write all handed-over records.
+        void wait()
+        {
+            if (_worker) {
+                _worker->wait();
+            }
+        }
+
+        // Writes out staged records and trims the dataset if the stream is
+        // buffered. Errors are silently ignored.
+        void close() noexcept
+        {
+            if (_staging) {
+                // Trim the dataset to successfully written records even if
+                // the background thread has failed.
+                try {
+                    drain();
+                    wait();
+                } catch (...) {
+                    // Must not throw.
+                }
+                try {
+                    _sink->trim();
+                } catch (...) {
+                }
+            }
+        }
+
+    private:
+        hid_t _file;
+        h5::shape<record_rank> _record_shape;
+        std::size_t _record_size = 1;
+        std::size_t _batch = 1;
+        std::size_t _position = 0;
+        hid_t _memory_type = -1;
+        hid_t (*_memory_type_source)() = nullptr;
+        std::unique_ptr<detail::stream_sink<data_rank>> _sink;
+        std::unique_ptr<detail::stream_staging> _staging;
+        std::unique_ptr<detail::stream_worker<data_rank>> _worker;
+        std::shared_ptr<detail::file_state> _state;
+        std::string _path;
+        std::size_t _written_bytes = 0;
+    };
+
+
+    namespace detail
+    {
+        // Converts `count` values of HDF5 memory type `src_type` in `src` to
+        // `dst_type` and stores them in `dst`.
+        inline void convert_values(
+            hid_t src_type,
+            hid_t dst_type,
+            void const* src,
+            void* dst,
+            std::size_t count
+        )
+        {
+            auto const src_size = H5Tget_size(src_type);
+            auto const dst_size = H5Tget_size(dst_type);
+
+            std::vector<unsigned char> buf(count * std::max(src_size, dst_size));
+            std::memcpy(buf.data(), src, count * src_size);
+
+            if (H5Tconvert(src_type, dst_type, count, buf.data(), nullptr, H5P_DEFAULT) < 0) {
+                throw h5::exception("failed to convert values");
+            }
+            std::memcpy(dst, buf.data(), count * dst_size);
+        }
+
+
+        // Reads records [start, start + count) of a dataset of rank
+        // `data_rank` into `buf`.
+        template<int data_rank>
+        void read_records(
+            hid_t dataset,
+            hid_t type,
+            hsize_t const* record_dims,
+            std::size_t start,
+            std::size_t count,
+            void* buf
+        )
+        {
+            hsize_t offset[data_rank] = {};
+            hsize_t dims[data_rank];
+            offset[0] = static_cast<hsize_t>(start);
+            dims[0] = static_cast<hsize_t>(count);
+            std::copy(record_dims, record_dims + data_rank - 1, dims + 1);
+
+            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
+            if (dataspace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+
+            auto status = H5Sselect_hyperslab(
+                dataspace, H5S_SELECT_SET, offset, nullptr, dims, nullptr
+            );
+            if (status < 0) {
+                throw h5::exception("failed to select hyperslab for streaming read");
+            }
+
+            h5::unique_hid<H5Sclose> memspace = H5Screate_simple(data_rank, dims, nullptr);
+            if (memspace < 0) {
+                throw h5::exception("failed to create dataspace");
+            }
+
+            status = H5Dread(dataset, type, memspace, dataspace, H5P_DEFAULT, buf);
+            if (status < 0) {
+                throw h5::exception("failed to read from dataset");
+            }
+        }
+    }
+
+
+    // Provides sequential read access to records in an HDF5 dataset.
+    //
+    // `stream_reader` reads arrays of rank `record_rank` in order from a
+    // dataset of rank `record_rank + 1`, typically one written by a
+    // `stream_writer`. Records are read in blocks of whole chunks into an
+    // internal buffer, so memory usage stays bounded regardless of the size
+    // of the dataset.
+    //
+    // With `prefetch` option the next block is read on a background thread
+    // while the caller consumes the current block. The same thread-safety
+    // caveat as asynchronous `stream_writer` applies.
+    //
+    template<typename D, int record_rank>
+    class stream_reader
+    {
+        static constexpr int data_rank = record_rank + 1;
+
+        static_assert(
+            !std::is_pointer<D>::value, "stream_reader does not support string dataset"
+        );
+
+        // Approximate size of a block read at once.
+        static constexpr std::size_t block_bytes = 4 * 1024 * 1024;
+
+    public:
+        // Constructor initiates reading from the beginning of the dataset.
+        //
+        // Parameters:
+        //   dataset = The dataset to read from.
+        //   options = Streaming options. This parameter is optional.
+        //
+        explicit stream_reader(
+            hid_t dataset,
+            h5::stream_reader_options const& options = h5::stream_reader_options{}
+        )
+            : _dataset{dataset}, _prefetch{options.prefetch}
+        {
+            hsize_t dims[data_rank];
+            {
+                h5::unique_hid<H5Sclose> dataspace = H5Dget_space(dataset);
+                if (dataspace < 0) {
+                    throw h5::exception("failed to determine dataspace");
+                }
+                if (H5Sget_simple_extent_dims(dataspace, dims, nullptr) != data_rank) {
+                    throw h5::exception("unexpected dataset rank");
+                }
+            }
+
+            _size = static_cast<std::size_t>(dims[0]);
+            std::copy(dims + 1, dims + data_rank, _record_dims);
+            detail::set_dims(_record_dims, _record_shape);
+
+            for (int i = 0; i < record_rank; i++) {
+                _record_size *= static_cast<std::size_t>(_record_dims[i]);
+            }
+
+            // Read whole chunks at once.
+            std::size_t chunk_records = 1;
+            hsize_t chunk_dims[data_rank];
+            if (detail::get_chunk_dims(dataset, data_rank, chunk_dims)) {
+                chunk_records = static_cast<std::size_t>(chunk_dims[0]);
+            }
+
+            auto const chunk_bytes = chunk_records * _record_size * sizeof(D);
+            auto const chunk_count = block_bytes / std::max(chunk_bytes, std::size_t(1));
+            _block_records = std::max(chunk_count, std::size_t(1)) * chunk_records;
+        }
+
+        ~stream_reader() noexcept
+        {
+            if (_next.valid()) {
+                _next.wait();
+            }
+        }
+
+        stream_reader(stream_reader&&) = default;
+        stream_reader& operator=(stream_reader&&) = delete;
+
+        // Returns the shape of each record.
+        h5::shape<record_rank> record_shape() const noexcept
+        {
+            return _record_shape;
+        }
+
+        // Returns the number of records in the dataset.
+        std::size_t size() const noexcept
+        {
+            return _size;
+        }
+
+        // Returns the index of the record to be read next.
+        std::size_t position() const noexcept
+        {
+            return _position;
+        }
+
+        // Reads the next record.
+        //
+        // Parameters:
+        //   T   = Type of the buffer. This must be compatible with the
+        //         dataset type `D`.
+        //   buf = Pointer to the buffer receiving flattened record.
+        //
+        // Returns:
+        //   `false` if all records have been read, `true` otherwise.
+        //
+        template<typename T>
+        bool read(T* buf)
+        {
+            return read_n(buf, 1) == 1;
+        }
+
+        // Calls `read` with buffer's underlying pointer.
+        template<
+            typename Buffer,
+            typename Tr = h5::buffer_traits<Buffer>,
+            typename T = typename Tr::value_type
+        >
+        bool read(Buffer& buffer)
+        {
+            if (Tr::shape(buffer) != _record_shape) {
+                throw h5::exception("buffer has unexpected shape");
+            }
+            return read(Tr::data(buffer));
+        }
+
+        // Reads at most `count` records.
+        //
+        // Parameters:
+        //   T     = Type of the buffer. This must be compatible with the
+        //           dataset type `D`.
+        //   buf   = Pointer to the buffer receiving flattened records.
+        //   count = Maximum number of records to read.
+        //
+        // Returns:
+        //   The number of records read. Zero if all records have been read.
+        //
+        template<typename T>
+        std::size_t read_n(T* buf, std::size_t count)
+        {
+            std::size_t done = 0;
+
+            while (done < count) {
+                if (_position == _block_start + _block_count) {
+                    if (!load_next()) {
+                        break;
+                    }
+                }
+
+                auto const offset = _position - _block_start;
+                auto const n = std::min(count - done, _block_count - offset);
+                auto const src = _block.data() + offset * _record_size;
+                auto const dst = buf + done * _record_size;
+
+                if (std::is_same<T, D>::value) {
+                    std::memcpy(dst, src, n * _record_size * sizeof(D));
+                } else {
+                    // Prefetching thread may be calling HDF5.
+                    std::lock_guard<std::mutex> library_lock{detail::library_mutex()};
+                    detail::convert_values(
+                        h5::memory_type<D>(), h5::memory_type<T>(), src, dst, n * _record_size
+                    );
+                }
+
+                _position += n;
+                done += n;
+            }
+
+            return done;
+        }
+
+        // Calls `read_n` with buffer's underlying pointer. The buffer must be
+        // an array of records and its first dimension is the maximum number
+        // of records to read.
+        template<
+            typename Buffer,
+            typename Tr = h5::buffer_traits<Buffer>,
+            typename T = typename Tr::value_type
+        >
+        std::size_t read_n(Buffer& buffer)
+        {
+            static_assert(Tr::rank == data_rank, "buffer must be an array of records");
+
+            auto const shape = Tr::shape(buffer);
+            h5::shape<record_rank> record_shape;
+            for (int i = 0; i < record_rank; i++) {
+                record_shape.dims[i] = shape.dims[i + 1];
+            }
+            if (record_shape != _record_shape) {
+                throw h5::exception("buffer has unexpected shape");
+            }
+            return read_n(Tr::data(buffer), shape.dims[0]);
+        }
+
+    private:
+        // Makes the block following the current one available. Returns false
+        // if there is no more record.
+        bool load_next()
+        {
+            auto const start = _block_start + _block_count;
+            if (start >= _size) {
+                return false;
+            }
+
+            if (_next.valid()) {
+                _next.get();
+                _block.swap(_next_block);
+            } else {
+                _block.resize(block_size(start) * _record_size);
+                fetch(start, _block.data());
+            }
+            _block_start = start;
+            _block_count = block_size(start);
+
+            auto const next_start = _block_start + _block_count;
+            if (_prefetch && next_start < _size) {
+                _next_block.resize(block_size(next_start) * _record_size);
+
+                // The task must not refer to `this` as the reader is movable.
+                hid_t const dataset = _dataset;
+                hsize_t record_dims[data_rank];
+                std::copy(_record_dims, _record_dims + record_rank, record_dims);
+                auto const count = block_size(next_start);
+                auto const buf = _next_block.data();
+
+                _next = std::async(std::launch::async, [=] {
+                    std::lock_guard<std::mutex> library_lock{detail::library_mutex()};
+                    try {
+                        detail::read_records<data_rank>(
+                            dataset, h5::memory_type<D>(), record_dims, next_start, count, buf
+                        );
+                    } catch (...) {
+                        H5Eclear2(H5E_DEFAULT);
+                        throw;
+                    }
+                });
+            }
+
+            return true;
+        }
+
+        std::size_t block_size(std::size_t start) const
+        {
+            return std::min(_block_records, _size - start);
+        }
+
+        void fetch(std::size_t start, D* buf)
+        {
+            detail::read_records<data_rank>(
+                _dataset, h5::memory_type<D>(), _record_dims, start, block_size(start), buf
+            );
+        }
+
+    private:
+        hid_t _dataset;
+        bool _prefetch;
+        h5::shape<record_rank> _record_shape;
+        hsize_t _record_dims[data_rank] = {};
+        std::size_t _record_size = 1;
+        std::size_t _size = 0;
+        std::size_t _block_records = 1;
+        std::size_t _position = 0;
+        std::size_t _block_start = 0;
+        std::size_t _block_count = 0;
+        std::vector<D> _block;
+        std::vector<D> _next_block;
+        std::future<void> _next;
+    };
+
+
+    // AUTO TUNING -----------------------------------------------------------
+
+    // Storage options chosen by `dataset::tune` and the measurements on
+    // which the choice is based.
+    struct tune_result
+    {
+        // The chosen options. Pass these to `dataset::write` or save the
+        // chunk shape and filter settings to pin them.
+        h5::dataset_options options;
+
+        // Number of candidate settings tried.
+        std::size_t trials = 0;
+
+        // Size in bytes of the sample written with the chosen options.
+        std::size_t sample_bytes = 0;
+
+        // Size in bytes the sample occupied in the file.
+        std::size_t stored_bytes = 0;
+
+        // Ratio of `sample_bytes` to `stored_bytes`.
+        double compression_ratio = 1;
+
+        // Time spent writing and reading the sample.
+        double write_seconds = 0;
+        double read_seconds = 0;
+    };
+
+
+    namespace detail
+    {
+        // Creates an empty HDF5 file in memory.
+        inline h5::unique_hid<H5Fclose> create_scratch_file()
+        {
+            static std::atomic<unsigned long> counter{0};
+            auto const name = "h5-scratch-" + std::to_string(counter++);
+
+            h5::unique_hid<H5Pclose> access_props = H5Pcreate(H5P_FILE_ACCESS);
+            if (access_props < 0) {
+                throw h5::exception("failed to create file access props");
+            }
+            if (H5Pset_fapl_core(access_props, 1024 * 1024, 0) < 0) {
+                throw h5::exception("failed to set core driver");
+            }
+
+            h5::unique_hid<H5Fclose> file = H5Fcreate(
+                name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, access_props
+            );
+            if (file < 0) {
+                throw h5::exception("cannot create scratch file");
+            }
+            return file;
+        }
+
+
+        // Writes `sample` to an in-memory file with given options, reads it
+        // back and records the storage size and timings in `result`.
+        template<typename D, int rank, typename T>
+        void run_tune_trial(
+            hid_t datatype,
+            std::vector<T> const& sample,
+            h5::shape<rank> const& sample_shape,
+            h5::dataset_options const& options,
+            h5::tune_result& result
+        )
+        {
+            using clock = std::chrono::steady_clock;
+
+            auto const file = detail::create_scratch_file();
+
+            auto const write_start = clock::now();
+            {
+                auto const dataset = detail::create_simple_dataset<D, rank>(
+                    file, "sample", datatype, sample_shape, options
+                );
+                if (detail::is_enum_datatype(datatype)) {
+                    detail::write_enum_dataset(dataset, sample.data(), sample.size(), datatype);
+                } else {
+                    detail::write_dataset(dataset, sample.data(), sample.size());
+                }
+            }
+            if (H5Fflush(file, H5F_SCOPE_LOCAL) < 0) {
+                throw h5::exception("failed to flush file");
+            }
+            std::chrono::duration<double> const write_time = clock::now() - write_start;
+
+            // Reopened dataset has an empty chunk cache, so the read below
+            // decodes every chunk.
+            h5::unique_hid<H5Dclose> dataset = H5Dopen2(file, "sample", H5P_DEFAULT);
+            if (dataset < 0) {
+                throw h5::exception("failed to open dataset");
+            }
+
+            std::vector<T> buf(sample.size());
+            auto const read_start = clock::now();
+            detail::read_dataset(dataset, buf.data(), buf.size());
+            std::chrono::duration<double> const read_time = clock::now() - read_start;
+
+            result.options = options;
+            result.sample_bytes = sample.size() * sizeof(D);
+            result.stored_bytes = static_cast<std::size_t>(H5Dget_storage_size(dataset));
+            result.compression_ratio =
+                double(result.sample_bytes) / double(std::max(result.stored_bytes, std::size_t(1)));
+            result.write_seconds = write_time.count();
+            result.read_seconds = read_time.count();
+        }
+
+
+        // Returns a shape consisting of whole chunks of `chunk`, fitting in
+        // `shape` and holding about `budget` bytes.
+        template<int rank>
+        h5::shape<rank> determine_sample_shape(
+            h5::shape<rank> const& shape,
+            h5::shape<rank> const& chunk,
+            std::size_t value_size,
+            std::size_t budget
+        )
+        {
+            auto sample = chunk;
+
+            for (bool grown = true; grown; ) {
+                grown = false;
+
+                for (int i = 0; i < rank; i++) {
+                    auto next = sample;
+                    next.dims[i] = std::min(2 * sample.dims[i], shape.dims[i]);
+                    if (next.dims[i] == sample.dims[i] || next.size() * value_size > budget) {
+                        continue;
+                    }
+                    sample = next;
+                    grown = true;
+                }
+            }
+
+            return sample;
+        }
+
+
+        // Tries candidate chunk shapes and filters on samples of `buf` and
+        // returns the candidate that best suits `goal`.
+        template<typename D, int rank, typename T>
+        h5::tune_result tune_dataset(
+            hid_t datatype,
+            T const* buf,
+            h5::shape<rank> const& shape,
+            h5::tune_goal goal,
+            h5::dataset_options const& base
+        )
+        {
+            // Samples are limited to this size to keep trials quick.
+            constexpr std::size_t sample_budget = 2 * 1024 * 1024;
+
+            // Disk bandwidth assumed in estimating read time. Timings on an
+            // in-memory file alone would always favor no compression.
+            constexpr double disk_bandwidth = 500e6;
+
+            h5::tune_result best;
+            best.options = base;
+            best.options.tune = detail::optional<h5::tune_goal>{};
+
+            if (std::is_pointer<T>::value || shape.size() == 0) {
+                return best;
+            }
+
+            // Candidate chunk shapes.
+            std::vector<h5::shape<rank>> chunks;
+
+            if (base.chunk) {
+                hsize_t chunk_dims[rank];
+                detail::get_explicit_chunk(base, rank, chunk_dims);
+
+                h5::shape<rank> chunk;
+                for (int i = 0; i < rank; i++) {
+                    chunk.dims[i] = std::max(
+                        std::min(std::size_t(chunk_dims[i]), shape.dims[i]), std::size_t(1)
+                    );
+                }
+                chunks.push_back(chunk);
+            } else {
+                for (auto const access : {
+                    base.access,
+                    h5::access_pattern::row_scan,
+                    h5::access_pattern::column_scan,
+                    h5::access_pattern::random_tile
+                }) {
+                    auto const chunk = detail::determine_chunk_size(shape, sizeof(D), access);
+                    if (std::find(chunks.begin(), chunks.end(), chunk) == chunks.end()) {
+                        chunks.push_back(chunk);
+                    }
+                }
+            }
+
+            // Candidate filters as (deflate level, scale-offset bits) pairs.
+            // Negative value means disabled. Scale-offset is lossy unless the
+            // bits are automatically chosen for an integral dataset, so it
+            // is not tried otherwise.
+            std::vector<std::pair<int, int>> filters;
+
+            for (int const level : {-1, 1, 5, 9}) {
+                if (base.scaleoffset) {
+                    filters.emplace_back(level, *base.scaleoffset);
+                    continue;
+                }
+                filters.emplace_back(level, -1);
+                if (std::is_integral<D>::value) {
+                    filters.emplace_back(level, 0);
+                }
+            }
+
+            // Estimated seconds to read a byte of the dataset.
+            auto read_cost = [&](h5::tune_result const& trial) {
+                auto const sample_bytes = double(trial.sample_bytes);
+                return (trial.read_seconds + double(trial.stored_bytes) / disk_bandwidth) / sample_bytes;
+            };
+
+            auto better = [&](h5::tune_result const& t1, h5::tune_result const& t2) {
+                auto const size1 = 1 / t1.compression_ratio;
+                auto const size2 = 1 / t2.compression_ratio;
+
+                switch (goal) {
+                case h5::tune_goal::size:
+                    if (size1 != size2) {
+                        return size1 < size2;
+                    }
+                    return read_cost(t1) < read_cost(t2);
+
+                case h5::tune_goal::read_speed:
+                    return read_cost(t1) < read_cost(t2);
+
+                case h5::tune_goal::balanced:
+                    break;
+                }
+                return size1 * read_cost(t1) < size2 * read_cost(t2);
+            };
+
+            std::size_t trials = 0;
+
+            for (auto const& chunk : chunks) {
+                // Sample whole chunks around the center of the buffer.
+                auto const sample_shape = detail::determine_sample_shape(
+                    shape, chunk, sizeof(D), sample_budget
+                );
+
+                hsize_t dims[rank];
+                hsize_t sample_dims[rank];
+                hsize_t offset[rank];
+                detail::set_dims(shape, dims);
+                detail::set_dims(sample_shape, sample_dims);
+                for (int i = 0; i < rank; i++) {
+                    auto const center = (dims[i] - sample_dims[i]) / 2;
+                    offset[i] = center - center % chunk.dims[i];
+                }
+
+                std::vector<T> sample(sample_shape.size());
+                detail::for_each_chunk_row(
+                    rank, dims, sample_dims, offset,
+                    [&](std::size_t array_index, std::size_t sample_index, std::size_t length) {
+                        std::copy_n(buf + array_index, length, sample.data() + sample_index);
+                    }
+                );
+
+                for (auto const& filter : filters) {
+                    h5::dataset_options options;
+                    options.access = base.access;
+                    options.threads = base.threads;
+                    options.chunk = std::vector<std::size_t>(chunk.dims, chunk.dims + rank);
+                    if (filter.first >= 0) {
+                        options.compression = filter.first;
+                    }
+                    if (filter.second >= 0) {
+                        options.scaleoffset = filter.second;
+                    }
+
+                    h5::tune_result trial;
+                    detail::run_tune_trial<D>(datatype, sample, sample_shape, options, trial);
+
+                    if (trials == 0 || better(trial, best)) {
+                        best = trial;
+                    }
+                    trials++;
+                }
+            }
+
+            best.trials = trials;
+
+            return best;
+        }
+    }
+
+
+    // MEMORY MAPPING --------------------------------------------------------
+
+    namespace detail
+    {
+        // Returns the name of the file containing `object`.
+        inline std::string get_file_name(hid_t object)
+        {
+            auto const size = H5Fget_name(object, nullptr, 0);
+            if (size < 0) {
+                throw h5::exception("failed to get file name");
+            }
+
+            std::vector<char> name(static_cast<std::size_t>(size) + 1);
+            if (H5Fget_name(object, name.data(), name.size()) < 0) {
+                throw h5::exception("failed to get file name");
+            }
+            return name.data();
+        }
+
+
+        // Selects the first `count` values of a simple dataspace in the
+        // flattened order. The selection is a union of at most rank
+        // hyperslabs.
+        inline void select_head(hid_t dataspace, hsize_t count)
+        {
+            hsize_t dims[H5S_MAX_RANK];
+            auto const rank = H5Sget_simple_extent_dims(dataspace, dims, nullptr);
+            if (rank < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+
+            if (H5Sselect_none(dataspace) < 0) {
+                throw h5::exception("failed to select values");
+            }
+
+            hsize_t start[H5S_MAX_RANK] = {};
+            auto remaining = count;
+            auto op = H5S_SELECT_SET;
+
+            for (int axis = 0; axis < rank; axis++) {
+                hsize_t row_size = 1;
+                for (int i = axis + 1; i < rank; i++) {
+                    row_size *= dims[i];
+                }
+
+                // Whole rows along this axis after the rows selected so far.
+                hsize_t block[H5S_MAX_RANK];
+                for (int i = 0; i < rank; i++) {
+                    block[i] = (i < axis ? 1 : i == axis ? remaining / row_size : dims[i]);
+                }
+                if (block[axis] > 0) {
+                    auto const status = H5Sselect_hyperslab(
+                        dataspace, op, start, nullptr, block, nullptr
+                    );
+                    if (status < 0) {
+                        throw h5::exception("failed to select values");
+                    }
+                    op = H5S_SELECT_OR;
+                }
+
+                start[axis] = remaining / row_size;
+                remaining %= row_size;
+            }
+        }
+
+
+        // Reads or writes the first `count` values of a dataset in the
+        // flattened order.
+        inline void transfer_head(
+            hid_t dataset, hid_t type, hsize_t count, void* buf, bool write
+        )
+        {
+            h5::unique_hid<H5Sclose> filespace = H5Dget_space(dataset);
+            if (filespace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+            detail::select_head(filespace, count);
+
+            h5::unique_hid<H5Sclose> memspace = H5Screate_simple(1, &count, nullptr);
+            if (memspace < 0) {
+                throw h5::exception("failed to create dataspace");
+            }
+
+            if (write) {
+                if (H5Dwrite(dataset, type, memspace, filespace, H5P_DEFAULT, buf) < 0) {
+                    throw h5::exception("failed to write to dataset");
+                }
+            } else {
+                if (H5Dread(dataset, type, memspace, filespace, H5P_DEFAULT, buf) < 0) {
+                    throw h5::exception("failed to read from dataset");
+                }
+            }
+        }
+
+
+        // Prepares `count` values of a contiguous dataset to be written
+        // through a mapping. Returns the number of leading values to write
+        // back through HDF5 after unmapping.
+        //
+        // HDF5 may not have extended the file to cover allocated but
+        // unwritten storage, and accessing such pages raises SIGBUS. The
+        // last value is read and rewritten through HDF5, which extends the
+        // file without resizing it behind HDF5.
+        //
+        // HDF5 also keeps up to `sieve_buf_size` bytes of recently accessed
+        // raw data of the dataset in a sieve buffer, which does not see
+        // writes to the mapping. Reading the first value moves the buffer to
+        // the head of the dataset, so writing the head back through HDF5
+        // after unmapping brings the buffer up to date.
+        //
+        inline hsize_t prepare_mapped_write(hid_t dataset, hid_t type, hsize_t count)
+        {
+            if (count == 0) {
+                return 0;
+            }
+
+            auto const value_size = H5Tget_size(type);
+
+            h5::unique_hid<H5Sclose> filespace = H5Dget_space(dataset);
+            if (filespace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+
+            hsize_t last[H5S_MAX_RANK];
+            auto const rank = H5Sget_simple_extent_dims(filespace, last, nullptr);
+            if (rank < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+            for (int i = 0; i < rank; i++) {
+                last[i]--;
+            }
+            if (H5Sselect_elements(filespace, H5S_SELECT_SET, 1, last) < 0) {
+                throw h5::exception("failed to select values");
+            }
+
+            hsize_t const one = 1;
+            h5::unique_hid<H5Sclose> memspace = H5Screate_simple(1, &one, nullptr);
+            if (memspace < 0) {
+                throw h5::exception("failed to create dataspace");
+            }
+
+            std::vector<unsigned char> value(value_size);
+            if (H5Dread(dataset, type, memspace, filespace, H5P_DEFAULT, value.data()) < 0) {
+                throw h5::exception("failed to read from dataset");
+            }
+            if (H5Dwrite(dataset, type, memspace, filespace, H5P_DEFAULT, value.data()) < 0) {
+                throw h5::exception("failed to write to dataset");
+            }
+
+            detail::transfer_head(dataset, type, 1, value.data(), false);
+
+            if (H5Fflush(dataset, H5F_SCOPE_LOCAL) < 0) {
+                throw h5::exception("failed to flush file");
+            }
+
+            h5::unique_hid<H5Fclose> file = H5Iget_file_id(dataset);
+            if (file < 0) {
+                throw h5::exception("failed to get file");
+            }
+            h5::unique_hid<H5Pclose> access_props = H5Fget_access_plist(file);
+            if (access_props < 0) {
+                throw h5::exception("failed to get file access props");
+            }
+            std::size_t sieve_size;
+            if (H5Pget_sieve_buf_size(access_props, &sieve_size) < 0) {
+                throw h5::exception("failed to get sieve buffer size");
+            }
+
+            auto const head = static_cast<hsize_t>((sieve_size + value_size - 1) / value_size);
+            return std::min(head, count);
+        }
+
+
+        // Memory-mapped storage of a contiguous dataset. The mapping holds a
+        // reference to the dataset, which keeps the dataset and its file
+        // open until the mapping is destroyed.
+        class file_mapping
+        {
+        public:
+            // Maps `count` values of memory type `type` at `offset` in the
+            // file containing `dataset`.
+            file_mapping(
+                hid_t dataset,
+                hid_t type,
+                std::size_t offset,
+                std::size_t count,
+                bool writable
+            )
+            {
+#ifdef SNSINFU_H5_HAS_MMAP
+                auto const size = count * H5Tget_size(type);
+
+                if (writable) {
+                    _head_count = detail::prepare_mapped_write(dataset, type, count);
+                }
+
+                auto const filename = detail::get_file_name(dataset);
+                auto const page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+                auto const page_offset = offset - offset % page_size;
+
+                int const fd = ::open(filename.c_str(), writable ? O_RDWR : O_RDONLY);
+                if (fd < 0) {
+                    throw h5::exception("failed to open file for mapping");
+                }
+
+                // Accessing pages past the end of the file raises SIGBUS.
+                struct stat file_stat;
+                auto const end = static_cast<off_t>(offset + size);
+                if (::fstat(fd, &file_stat) != 0 || file_stat.st_size < end) {
+                    ::close(fd);
+                    throw h5::exception("file is shorter than the mapped region");
+                }
+
+                _size = offset - page_offset + size;
+                _address = ::mmap(
+                    nullptr,
+                    _size,
+                    writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                    MAP_SHARED,
+                    fd,
+                    static_cast<off_t>(page_offset)
+                );
+                ::close(fd);
+
+                if (_address == MAP_FAILED) {
+                    throw h5::exception("failed to map file");
+                }
+                _data = static_cast<char*>(_address) + (offset - page_offset);
+
+                if (H5Iinc_ref(dataset) < 0) {
+                    ::munmap(_address, _size);
+                    throw h5::exception("failed to reference dataset");
+                }
+                _dataset = dataset;
+                _type = type;
+#else
+                (void) dataset;
+                (void) type;
+                (void) offset;
+                (void) count;
+                (void) writable;
+                throw h5::exception("memory mapping is not supported");
+#endif
+            }
+
+            // Unmaps the storage. For a writable mapping, the values HDF5 may
+            // have cached are written back through HDF5 so that later reads
+            // see the mapped writes. Errors are silently ignored.
+            ~file_mapping()
+            {
+#ifdef SNSINFU_H5_HAS_MMAP
+                std::vector<unsigned char> head;
+                if (_head_count > 0) {
+                    auto const begin = static_cast<unsigned char const*>(_data);
+                    auto const size = static_cast<std::size_t>(_head_count) * H5Tget_size(_type);
+                    head.assign(begin, begin + size);
+                }
+
+                ::munmap(_address, _size);
+
+                if (_head_count > 0) {
+                    try {
+                        detail::transfer_head(_dataset, _type, _head_count, head.data(), true);
+                    } catch (...) {
+                        // Must not throw.
+                    }
+                }
+#endif
+            }
+
+            file_mapping(file_mapping const&) = delete;
+            file_mapping& operator=(file_mapping const&) = delete;
+
+
+            // Returns the pointer to the first mapped byte.
+            void* data() const noexcept
+            {
+                return _data;
+            }
+
+        private:
+            h5::unique_hid<H5Dclose> _dataset;
+            hid_t _type = -1;
+            hsize_t _head_count = 0;
+            void* _address = nullptr;
+            void* _data = nullptr;
+            std::size_t _size = 0;
+        };
+
+
+        // Returns the file offset of a contiguous dataset stored as native
+        // `T` values. Throws an exception if the dataset cannot be mapped.
+        // Returns `HADDR_UNDEF` if the storage is not allocated.
+        template<typename T>
+        haddr_t get_mappable_offset(hid_t dataset)
+        {
+            h5::unique_hid<H5Pclose> dataset_props = H5Dget_create_plist(dataset);
+            if (dataset_props < 0) {
+                throw h5::exception("failed to get dataset props");
+            }
+            if (H5Pget_layout(dataset_props) != H5D_CONTIGUOUS) {
+                throw h5::exception("cannot map non-contiguous dataset");
+            }
+            if (H5Pget_external_count(dataset_props) != 0) {
+                throw h5::exception("cannot map external dataset");
+            }
+
+            h5::unique_hid<H5Tclose> datatype = H5Dget_type(dataset);
+            if (datatype < 0) {
+                throw h5::exception("failed to get dataset type");
+            }
+            auto const type_class = H5Tget_class(datatype);
+            if (type_class != H5T_INTEGER && type_class != H5T_FLOAT) {
+                throw h5::exception("cannot map non-numeric dataset");
+            }
+            if (H5Tequal(datatype, h5::memory_type<T>()) <= 0) {
+                throw h5::exception("cannot map dataset of non-native type");
+            }
+
+            // Driver must store the file as is on disk.
+            h5::unique_hid<H5Fclose> file = H5Iget_file_id(dataset);
+            if (file < 0) {
+                throw h5::exception("failed to get file");
+            }
+            h5::unique_hid<H5Pclose> access_props = H5Fget_access_plist(file);
+            if (access_props < 0) {
+                throw h5::exception("failed to get file access props");
+            }
+            auto const driver = H5Pget_driver(access_props);
+            if (driver != H5FD_SEC2 && driver != H5FD_STDIO) {
+                throw h5::exception("cannot map file with this driver");
+            }
+
+            // Data written through HDF5 may still be buffered.
+            if (H5Fflush(dataset, H5F_SCOPE_LOCAL) < 0) {
+                throw h5::exception("failed to flush file");
+            }
+
+            return H5Dget_offset(dataset);
+        }
+    }
+
+
+    // Array view of dataset storage mapped into memory. Returned from
+    // `dataset::map`.
+    //
+    // The view keeps the dataset, and with it the HDF5 file, open until the
+    // view is destroyed, so it stays valid after the `dataset` and `file`
+    // objects are destroyed. Its content is undefined, however, once the
+    // dataset is rewritten or deleted.
+    //
+    template<typename T, int rank>
+    class mapped_array
+    {
+    public:
+        using value_type = T;
+
+
+        // Creates an empty view.
+        mapped_array() = default;
+
+
+        // Creates a view of `shape` values in `mapping`.
+        mapped_array(
+            std::shared_ptr<detail::file_mapping> mapping, h5::shape<rank> const& shape
+        )
+            : _mapping{std::move(mapping)}
+            , _shape{shape}
+        {
+        }
+
+
+        // Returns the pointer to the first value.
+        T* data() const noexcept
+        {
+            return _mapping ? static_cast<T*>(_mapping->data()) : nullptr;
+        }
+
+
+        // Returns the shape of the array.
+        h5::shape<rank> const& shape() const noexcept
+        {
+            return _shape;
+        }
+
+
+        // Returns the number of values in the array.
+        std::size_t size() const noexcept
+        {
+            return _mapping ? _shape.size() : 0;
+        }
+
+
+        // Returns the `index`-th value in the flattened array.
+        T& operator[](std::size_t index) const
+        {
+            return data()[index];
+        }
+
+
+        // Returns the iterators of the flattened array.
+        T* begin() const noexcept
+        {
+            return data();
+        }
+
+        T* end() const noexcept
+        {
+            return data() + size();
+        }
+
+    private:
+        std::shared_ptr<detail::file_mapping> _mapping;
+        h5::shape<rank> _shape = {};
+    };
+
+
+    class file;
+
+
+    // Provides read/write access to an HDF5 dataset.
+    //
+    // The type `D` asserts the expected datatype on disk. `rank` asserts the
+    // expected rank of the dataset. Zero `rank` means a scalar dataset.
+    //
+    template<typename D, int rank>
+    class dataset
+    {
+    public:
+        static_assert(rank > 0, "rank must be positive");
+
+
+        // Tries to open a simple dataset on the `path` in `file`.
+        //
+        // If the path does not exist, the constructor just initializes the
+        // object in the empty state. The object can be used to create a new
+        // dataset on the path by calling `write`.
+        //
+        // If the path is not a simple dataset, or if the type and/or rank
+        // assertion fails, the constructor throws an `h5::exception`.
+        //
+        // The behavior is undefined if a `dataset` object outlives `file`.
+        // Make sure `dataset` is destroyed before the file it originates.
+        //
+        dataset(hid_t file, std::string const& path)
+            : dataset{file, path, h5::dataset_access_options{}}
+        {
+        }
+
+
+        // Tries to open a dataset with given access options. The options
+        // are also used for the datasets this object creates.
+        dataset(
+            hid_t file,
+            std::string const& path,
+            h5::dataset_access_options const& access_options
+        )
+            : dataset{file, path, access_options, nullptr}
+        {
+        }
+
+
+        // Tries to open a simple enum dataset on the `path` in `file`.
+        //
+        // This constructor works just like `dataset(file, path)`, but does
+        // additional type check of enum members against dataset if exists.
+        //
+        dataset(hid_t file, std::string const& path, h5::enums<D> const& enums)
+            : dataset{file, path, enums, h5::dataset_access_options{}}
+        {
+        }
+
+
+        // Tries to open an enum dataset with given access options.
+        dataset(
+            hid_t file,
+            std::string const& path,
+            h5::enums<D> const& enums,
+            h5::dataset_access_options const& access_options
+        )
+            : dataset{file, path, enums, access_options, nullptr}
+        {
+        }
+
+
+        // Returns `true` if the object holds a dataset.
+        explicit operator bool() const noexcept
+        {
+            return _dataset >= 0;
+        }
+
+
+        // Returns the underlying dataset HID. Returns -1 if the object does
+        // not hold a dataset.
+        hid_t handle() const noexcept
+        {
+            return _dataset;
+        }
+
+
+        // Retrieves the shape of the dataset. Returns a zero shape if the
+        // object does not hold a dataset.
+        h5::shape<rank> shape() const noexcept
+        {
+            if (_dataset < 0) {
+                return {};
+            }
+            if (_fixed_shape) {
+                return _shape;
+            }
+            return detail::check_dataset_rank<rank>(_dataset);
+        }
+
+
+        // Retrieves the chunk shape of the dataset. Returns a zero shape if
+        // the object does not hold a dataset or the dataset is not chunked.
+        h5::shape<rank> chunk_shape() const
+        {
+            h5::shape<rank> shape = {};
+
+            hsize_t chunk_dims[rank];
+            if (_dataset >= 0 && detail::get_chunk_dims(_dataset, rank, chunk_dims)) {
+                detail::set_dims(chunk_dims, shape);
+            }
+            return shape;
+        }
+
+
+        // Reads all data from the dataset.
+        //
+        // The function throws an `h5::exception` if dataset is not open or
+        // the given `shape` is not the same as that of dataset.
+        //
+        // Parameters:
+        //   T       = Type of the buffer. This must be compatible with the
+        //             dataset type `D`.
+        //   buf     = Pointer to the buffer.
+        //   shape   = Shape of the buffer.
+        //   options = Options for reading.
         //
         template<typename T>
-        void write(T const* buf)
+        void read(T* buf, h5::shape<rank> const& shape, h5::read_options const& options)
         {
-            herr_t status;
+            if (this->shape() != shape) {
+                throw h5::exception("shape mismatch when reading");
+            }
 
-            _datadims[0]++;
-            status = H5Dset_extent(_dataset, _datadims);
-            if (status < 0) {
-                throw h5::exception("failed to extend unlimited dataset");
+            if (options.threads && !std::is_pointer<T>::value) {
+                if (detail::read_chunks_parallel(_dataset, buf, *options.threads)) {
+                    return;
+                }
             }
 
-            status = H5Sset_extent_simple(_dataspace, data_rank, _datadims, _maxdims);
-            if (status < 0) {
-                throw h5::exception("failed to extend dataspace");
+            detail::read_dataset(_dataset, buf, shape.size());
+        }
+
+
+        // Calls `read` with default options.
+        template<typename T>
+        void read(T* buf, h5::shape<rank> const& shape)
+        {
+            h5::read_options default_options;
+            read(buf, shape, default_options);
+        }
+
+
+        // Calls `read` with buffer's underlying pointer.
+        template<
+            typename Buffer,
+            typename Tr = h5::buffer_traits<Buffer>,
+            typename T = typename Tr::value_type
+        >
+        void read(Buffer& buffer, h5::read_options const& options)
+        {
+            read(Tr::data(buffer), Tr::shape(buffer), options);
+        }
+
+
+        // Calls `read` with buffer's underlying pointer.
+        template<
+            typename Buffer,
+            typename Tr = h5::buffer_traits<Buffer>,
+            typename T = typename Tr::value_type
+        >
+        void read(Buffer& buffer)
+        {
+            read(Tr::data(buffer), Tr::shape(buffer));
+        }
+
+
+        // Reads all data from the dataset, resizing buffer to the shape of the
+        // dataset. See `read` for details. The buffer traits needs to support
+        // `reshape` operation.
+        template<
+            typename Buffer,
+            typename Tr = h5::buffer_traits<Buffer>,
+            typename T = typename Tr::value_type
+        >
+        void read_fit(Buffer& buffer, h5::read_options const& options)
+        {
+            Tr::reshape(buffer, shape());
+            read(Tr::data(buffer), Tr::shape(buffer), options);
+        }
+
+
+        // Calls `read_fit` with default options.
+        template<
+            typename Buffer,
+            typename Tr = h5::buffer_traits<Buffer>,
+            typename T = typename Tr::value_type
+        >
+        void read_fit(Buffer& buffer)
+        {
+            h5::read_options default_options;
+            read_fit(buffer, default_options);
+        }
+
+
+        // Reads a region of the dataset.
+        //
+        // The region consists of `count` elements along each axis, starting
+        // at `offset` and spaced by `stride`. The function throws an
+        // `h5::exception` if dataset is not open or the region does not fit
+        // in the dataset.
+        //
+        // Parameters:
+        //   T      = Type of the buffer. This must be compatible with the
+        //            dataset type `D`.
+        //   buf    = Pointer to the buffer. The shape of the buffer must be
+        //            `count`.
+        //   offset = Index of the first element of the region.
+        //   count  = Number of elements in the region along each axis.
+        //   stride = Step between elements along each axis. Optional.
+        //
+        template<typename T>
+        void read_slice(
+            T* buf,
+            h5::shape<rank> const& offset,
+            h5::shape<rank> const& count,
+            h5::shape<rank> const& stride
+        )
+        {
+            if (_dataset < 0) {
+                throw h5::exception("dataset is not open");
+            }
+
+            auto const filespace = detail::select_slice(_dataset, offset, count, stride);
+            auto const memspace = detail::create_memspace(count);
+            detail::read_dataset(_dataset, buf, count.size(), memspace, filespace);
+        }
+
+
+        // Calls `read_slice` with unit stride.
+        template<typename T>
+        void read_slice(
+            T* buf, h5::shape<rank> const& offset, h5::shape<rank> const& count
+        )
+        {
+            read_slice(buf, offset, count, detail::unit_shape<rank>());
+        }
+
+
+        // Calls `read_slice` with buffer's underlying pointer. The region has
+        // the same shape as the buffer.
+        template<
+            typename Buffer,
+            typename Tr = h5::buffer_traits<Buffer>,
+            typename T = typename Tr::value_type
+        >
+        void read_slice(
+            Buffer& buffer,
+            h5::shape<rank> const& offset,
+            h5::shape<rank> const& stride
+        )
+        {
+            read_slice(Tr::data(buffer), offset, Tr::shape(buffer), stride);
+        }
+
+
+        template<
+            typename Buffer,
+            typename Tr = h5::buffer_traits<Buffer>,
+            typename T = typename Tr::value_type
+        >
+        void read_slice(Buffer& buffer, h5::shape<rank> const& offset)
+        {
+            read_slice(Tr::data(buffer), offset, Tr::shape(buffer));
+        }
+
+
+        // Reads rows of the dataset at given indices. A row is a sub-array
+        // indexed by the first dimension.
+        //
+        // All rows are gathered with a single read, so each chunk is read
+        // and decompressed at most once. Indices may be in any order and
+        // may contain duplicates; rows are stored in `buf` in the order of
+        // `indices`. The function throws an `h5::exception` if dataset is
+        // not open or an index is out of bounds.
+        //
+        // Parameters:
+        //   T       = Type of the buffer. This must be compatible with the
+        //             dataset type `D`.
+        //   buf     = Pointer to the buffer. The buffer must have room for
+        //             `indices.size()` rows.
+        //   indices = Indices of the rows to read.
+        //
+        template<typename T>
+        void read_rows(T* buf, std::vector<std::size_t> const& indices)
+        {
+            if (_dataset < 0) {
+                throw h5::exception("dataset is not open");
+            }
+            auto const shape = this->shape();
+
+            std::size_t row_size = 1;
+            for (int i = 1; i < rank; i++) {
+                row_size *= shape.dims[i];
+            }
+
+            auto const rows = detail::sort_unique(indices);
+            if (!rows.empty() && rows.back() >= shape.dims[0]) {
+                throw h5::exception("row index is out of dataset bounds");
+            }
+
+            // Coalesce consecutive rows into a block.
+            std::vector<std::pair<hsize_t, hsize_t>> blocks;
+            for (std::size_t begin = 0, end; begin < rows.size(); begin = end) {
+                for (end = begin + 1; end < rows.size(); end++) {
+                    if (rows[end] != rows[end - 1] + 1) {
+                        break;
+                    }
+                }
+                blocks.emplace_back(rows[begin], end - begin);
+            }
+
+            h5::unique_hid<H5Sclose> dataspace = H5Dget_space(_dataset);
+            if (dataspace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+            auto const filespace = detail::select_row_blocks<rank>(
+                dataspace, blocks.data(), blocks.size()
+            );
+
+            h5::shape<1> const gathered_shape = {rows.size() * row_size};
+            auto const memspace = detail::create_memspace(gathered_shape);
+
+            if (rows == indices) {
+                // Already sorted. Read directly into the buffer.
+                detail::read_dataset(_dataset, buf, gathered_shape.size(), memspace, filespace);
+                return;
             }
 
-            status = H5Sselect_hyperslab(
-                _dataspace, H5S_SELECT_SET, _offset, nullptr, _memdims, nullptr
+            std::vector<T> gathered(gathered_shape.size());
+            detail::read_dataset(
+                _dataset, gathered.data(), gathered_shape.size(), memspace, filespace
             );
+
+            for (std::size_t i = 0; i < indices.size(); i++) {
+                auto const pos = static_cast<std::size_t>(
+                    std::lower_bound(rows.begin(), rows.end(), indices[i]) - rows.begin()
+                );
+                auto const src = gathered.begin() + static_cast<std::ptrdiff_t>(pos * row_size);
+                std::copy(src, src + static_cast<std::ptrdiff_t>(row_size), buf + i * row_size);
+            }
+        }
+
+
+        // Reads elements of the dataset at given coordinates.
+        //
+        // This function works like `read_rows` but gathers individual
+        // elements using a point selection. Values are stored in `buf` in
+        // the order of `coords`.
+        //
+        // Parameters:
+        //   T      = Type of the buffer. This must be compatible with the
+        //            dataset type `D`.
+        //   buf    = Pointer to the buffer. The buffer must have room for
+        //            `coords.size()` values.
+        //   coords = Coordinates of the elements to read.
+        //
+        template<typename T>
+        void read_points(T* buf, std::vector<h5::shape<rank>> const& coords)
+        {
+            if (_dataset < 0) {
+                throw h5::exception("dataset is not open");
+            }
+            auto const shape = this->shape();
+
+            // Sorting points in the storage order lets libhdf5 visit each
+            // chunk once.
+            auto const points = detail::sort_unique(coords);
+
+            std::vector<hsize_t> point_dims(points.size() * rank);
+            for (std::size_t i = 0; i < points.size(); i++) {
+                for (int j = 0; j < rank; j++) {
+                    if (points[i].dims[j] >= shape.dims[j]) {
+                        throw h5::exception("point is out of dataset bounds");
+                    }
+                }
+                detail::set_dims(points[i], point_dims.data() + i * rank);
+            }
+
+            h5::unique_hid<H5Sclose> filespace = H5Dget_space(_dataset);
+            if (filespace < 0) {
+                throw h5::exception("failed to determine dataspace");
+            }
+
+            herr_t status;
+            if (points.empty()) {
+                status = H5Sselect_none(filespace);
+            } else {
+                status = H5Sselect_elements(
+                    filespace, H5S_SELECT_SET, points.size(), point_dims.data()
+                );
+            }
             if (status < 0) {
-                throw h5::exception("failed to select hyperslab for streaming write");
+                throw h5::exception("failed to select points");
             }
 
-            status = H5Dwrite(
-                _dataset, h5::memory_type<T>(), _memspace, _dataspace, H5P_DEFAULT, buf
+            h5::shape<1> const gathered_shape = {points.size()};
+            auto const memspace = detail::create_memspace(gathered_shape);
+
+            std::vector<T> gathered(points.size());
+            detail::read_dataset(
+                _dataset, gathered.data(), gathered.size(), memspace, filespace
             );
-            if (status < 0) {
-                throw h5::exception("failed to write to dataset");
-            }
 
-            _offset[0] = _datadims[0];
+            for (std::size_t i = 0; i < coords.size(); i++) {
+                auto const pos = std::lower_bound(
+                    points.begin(), points.end(), coords[i], detail::shape_less<rank>
+                ) - points.begin();
+                buf[i] = gathered[static_cast<std::size_t>(pos)];
+            }
         }
 
-        // Calls `write` with buffer's underlying pointer.
-        template<
-            typename Buffer,
-            typename Tr = h5::buffer_traits<Buffer>,
-            typename T = typename Tr::value_type
-        >
-        void write(Buffer& buffer)
+
+        // Maps the dataset storage into memory and returns a read-only view.
+        //
+        // Values are read from the file on demand and the page cache is
+        // shared with other processes mapping the same file, so the cost of
+        // this function does not depend on the dataset size.
+        //
+        // The dataset must be contiguous (neither chunked nor compressed) and
+        // its datatype must be the same as the native `T`. The file must be
+        // opened with the default driver. Otherwise, or if the platform does
+        // not support `mmap`, the function throws an `h5::exception`.
+        //
+        template<typename T = D>
+        h5::mapped_array<T const, rank> map() const
         {
-            if (Tr::shape(buffer) != _record_shape) {
-                throw h5::exception("buffer has unexpected shape");
-            }
-            write(Tr::data(buffer));
+            return {map_storage<T>(false), shape()};
         }
 
-        // Flushes written data to disk.
-        void flush()
+
+        // Maps the dataset storage into memory and returns a writable view.
+        //
+        // Values stored in the view are written to the file by the kernel,
+        // bypassing HDF5. Use `allocate` to create a dataset to fill. The
+        // file must be opened for writing. Other requirements are the same
+        // as `map`.
+        //
+        // HDF5 caches small reads of raw data. Do not access the dataset
+        // through HDF5 while the view exists. When the view is destroyed,
+        // the cached data is brought up to date, so later reads through HDF5
+        // see the values written to the view.
+        //
+        template<typename T = D>
+        h5::mapped_array<T, rank> map_writable() const
         {
-            if (H5Fflush(_file, H5F_SCOPE_LOCAL) < 0) {
-                throw h5::exception("failed to flush streaming changes to disk");
-            }
+            return {map_storage<T>(true), shape()};
         }
 
-    private:
-        hid_t _file;
-        hid_t _dataset;
-        h5::shape<record_rank> _record_shape;
-        h5::unique_hid<H5Sclose> _dataspace;
-        h5::unique_hid<H5Sclose> _memspace;
-        hsize_t _maxdims[data_rank] = {};
-        hsize_t _datadims[data_rank] = {};
-        hsize_t _memdims[data_rank] = {};
-        hsize_t _offset[data_rank] = {};
-    };
 
+        // Creates a new dataset of given shape without writing data.
+        //
+        // The storage is allocated immediately, so the dataset can be mapped
+        // by `map_writable` and filled in place. An existing dataset is
+        // reused or replaced as in `write`. Values are undefined until
+        // written.
+        //
+        // Parameters:
+        //   shape   = Shape of the dataset.
+        //   options = Options for the newly created dataset. Leave filters
+        //             and chunk shape unset to allow mapping.
+        //
+        void allocate(h5::shape<rank> const& shape, h5::dataset_options const& options = {})
+        {
+            auto allocate_options = options;
+            allocate_options.early_allocation = true;
+            prepare(shape, allocate_options);
 
-    // Provides read/write access to an HDF5 dataset.
-    //
-    // The type `D` asserts the expected datatype on disk. `rank` asserts the
-    // expected rank of the dataset. Zero `rank` means a scalar dataset.
-    //
-    template<typename D, int rank>
-    class dataset
-    {
-    public:
-        static_assert(rank > 0, "rank must be positive");
+            detail::notify_write(_state.get(), _file, _path, 0);
+        }
 
 
-        // Tries to open a simple dataset on the `path` in `file`.
+        // Writes a new dataset of given shape.
         //
-        // If the path does not exist, the constructor just initializes the
-        // object in the empty state. The object can be used to create a new
-        // dataset on the path by calling `write`.
+        // The function writes flattened data pointed-to by `buf` to the path.
+        // If the existing dataset has the same shape, datatype and storage
+        // options, the data is overwritten in place. Otherwise, a new dataset
+        // is created, clobbering existing one if any. Ancestor groups are
+        // created if not exist.
         //
-        // If the path is not a simple dataset, or if the type and/or rank
-        // assertion fails, the constructor throws an `h5::exception`.
+        // XXX: Current implementation is not exception safe. Old dataset will
+        // be lost if writing a new dataset fails.
         //
-        // The behavior is undefined if a `dataset` object outlives `file`.
-        // Make sure `dataset` is destroyed before the file it originates.
+        // Parameters:
+        //   T       = Type of the buffer. This must be compatible with the
+        //             dataset type `D`.
+        //   buf     = Pointer to the buffer.
+        //   shape   = Shape of the buffer.
+        //   options = Options for the newly created dataset.
         //
-        dataset(hid_t file, std::string const& path)
-            : _file{file}, _path{path}
+        template<typename T>
+        void write(
+            T const* buf,
+            h5::shape<rank> const& shape,
+            h5::dataset_options const& options
+        )
         {
-            if (detail::check_path_exists(file, path)) {
-                _dataset = H5Dopen2(file, path.c_str(), H5P_DEFAULT);
-                if (_dataset < 0) {
-                    throw h5::exception("failed to open dataset");
-                }
+            if (options.tune && !std::is_pointer<T>::value) {
+                auto const tuned = tune(buf, shape, *options.tune, options);
+                write(buf, shape, tuned.options);
+                return;
+            }
 
-                detail::check_dataset_rank<rank>(_dataset);
-                detail::check_dataset_type<D>(_dataset);
+            auto const datatype = prepare(shape, options);
+
+            bool written = false;
+
+            if (options.threads && !std::is_pointer<T>::value && !detail::is_enum_datatype(datatype)) {
+                written = detail::write_chunks_parallel(_dataset, buf, *options.threads);
+            }
+
+            if (!written) {
+                if (detail::is_enum_datatype(datatype)) {
+                    detail::write_enum_dataset(_dataset, buf, shape.size(), datatype);
+                } else {
+                    detail::write_dataset(_dataset, buf, shape.size());
+                }
             }
+
+            detail::notify_write(_state.get(), _file, _path, shape.size() * sizeof(T));
         }
 
 
-        // Tries to open a simple enum dataset on the `path` in `file`.
-        //
-        // This constructor works just like `dataset(file, path)`, but does
-        // additional type check of enum members against dataset if exists.
-        //
-        dataset(hid_t file, std::string const& path, h5::enums<D> const& enums)
-            : dataset{file, path}
+        // Calls `write` with default options.
+        template<typename T>
+        void write(T const* buf, h5::shape<rank> const& shape)
         {
-            _given_datatype = detail::make_enum_type(enums);
-
-            if (_dataset >= 0) {
-                detail::check_dataset_enums(_dataset, enums);
-            }
+            h5::dataset_options default_options;
+            return write(buf, shape, default_options);
         }
 
 
-        // Returns `true` if the object holds a dataset.
-        explicit operator bool() const noexcept
+        // Chooses storage options for writing given data by trial.
+        //
+        // The function takes samples of whole chunks from the center of
+        // `buf` and writes them to an in-memory file with candidate chunk
+        // shapes (one for each `access_pattern`) and filters (deflate levels
+        // 1, 5 and 9, and lossless scale-offset for integers). Then it
+        // measures the storage size and the time to read each sample back,
+        // and returns the candidate best for `goal`. Read time is estimated
+        // assuming 500 MB/s disk.
+        //
+        // The dataset is not modified. Pass the returned options to `write`
+        // to store data with the chosen settings, or record them to pin the
+        // settings. Setting `dataset_options::tune` does both in one call.
+        //
+        // Parameters:
+        //   T     = Type of the buffer. This must be compatible with the
+        //           dataset type `D`.
+        //   buf   = Pointer to the buffer.
+        //   shape = Shape of the buffer.
+        //   goal  = What to optimize.
+        //   base  = Options the candidates derive from. Explicit `chunk` and
+        //           `scaleoffset` are not tuned.
+        //
+        template<typename T>
+        h5::tune_result tune(
+            T const* buf,
+            h5::shape<rank> const& shape,
+            h5::tune_goal goal,
+            h5::dataset_options const& base = {}
+        ) const
         {
-            return _dataset >= 0;
+            hid_t datatype = h5::storage_type<D>();
+            if (_given_datatype >= 0) {
+                datatype = _given_datatype;
+            }
+            return detail::tune_dataset<D>(datatype, buf, shape, goal, base);
         }
 
 
-        // Returns the underlying dataset HID. Returns -1 if the object does
-        // not hold a dataset.
-        hid_t handle() const noexcept
+        // Calls `write` with buffer's underlying pointer.
+        template<
+            typename Buffer,
+            typename Tr = h5::buffer_traits<Buffer>,
+            typename T = typename Tr::value_type
+        >
+        void write(Buffer const& buffer, h5::dataset_options const& options)
         {
-            return _dataset;
+            write(Tr::data(buffer), Tr::shape(buffer), options);
         }
 
 
-        // Retrieves the shape of the dataset. Returns a zero shape if the
-        // object does not hold a dataset.
-        h5::shape<rank> shape() const noexcept
+        // Calls `write` with buffer's underlying pointer.
+        template<
+            typename Buffer,
+            typename Tr = h5::buffer_traits<Buffer>,
+            typename T = typename Tr::value_type
+        >
+        void write(Buffer const& buffer)
         {
-            if (_dataset < 0) {
-                return {};
-            }
-            return detail::check_dataset_rank<rank>(_dataset);
+            write(Tr::data(buffer), Tr::shape(buffer));
         }
 
 
-        // Reads all data from the dataset.
+        // Overwrites a region of the existing dataset in place.
         //
-        // The function throws an `h5::exception` if dataset is not open or
-        // the given `shape` is not the same as that of dataset.
+        // The region is specified in the same way as `read_slice`. The shape
+        // and options of the dataset are not changed. The function throws an
+        // `h5::exception` if dataset is not open or the region does not fit
+        // in the dataset.
         //
         // Parameters:
-        //   T     = Type of the buffer. This must be compatible with the
-        //           dataset type `D`.
-        //   buf   = Pointer to the buffer.
-        //   shape = Shape of the buffer.
+        //   T      = Type of the buffer. This must be compatible with the
+        //            dataset type `D`.
+        //   buf    = Pointer to the buffer. The shape of the buffer must be
+        //            `count`.
+        //   offset = Index of the first element of the region.
+        //   count  = Number of elements in the region along each axis.
+        //   stride = Step between elements along each axis. Optional.
         //
         template<typename T>
-        void read(T* buf, h5::shape<rank> const& shape)
+        void write_slice(
+            T const* buf,
+            h5::shape<rank> const& offset,
+            h5::shape<rank> const& count,
+            h5::shape<rank> const& stride
+        )
         {
-            if (this->shape() != shape) {
-                throw h5::exception("shape mismatch when reading");
+            if (_dataset < 0) {
+                throw h5::exception("dataset is not open");
             }
 
-            detail::read_dataset(_dataset, buf, shape.size());
+            auto const filespace = detail::select_slice(_dataset, offset, count, stride);
+            auto const memspace = detail::create_memspace(count);
+
+            if (_given_datatype >= 0) {
+                detail::write_enum_dataset(
+                    _dataset, buf, count.size(), _given_datatype, memspace, filespace
+                );
+            } else {
+                detail::write_dataset(_dataset, buf, count.size(), memspace, filespace);
+            }
+
+            detail::notify_write(_state.get(), _file, _path, count.size() * sizeof(T));
         }
 
 
-        // Calls `read` with buffer's underlying pointer.
+        // Calls `write_slice` with unit stride.
+        template<typename T>
+        void write_slice(
+            T const* buf, h5::shape<rank> const& offset, h5::shape<rank> const& count
+        )
+        {
+            write_slice(buf, offset, count, detail::unit_shape<rank>());
+        }
+
+
+        // Calls `write_slice` with buffer's underlying pointer. The region has
+        // the same shape as the buffer.
         template<
             typename Buffer,
             typename Tr = h5::buffer_traits<Buffer>,
             typename T = typename Tr::value_type
         >
-        void read(Buffer& buffer)
+        void write_slice(
+            Buffer const& buffer,
+            h5::shape<rank> const& offset,
+            h5::shape<rank> const& stride
+        )
         {
-            read(Tr::data(buffer), Tr::shape(buffer));
+            write_slice(Tr::data(buffer), offset, Tr::shape(buffer), stride);
         }
 
 
-        // Reads all data from the dataset, resizing buffer to the shape of the
-        // dataset. See `read` for details. The buffer traits needs to support
-        // `reshape` operation.
         template<
             typename Buffer,
             typename Tr = h5::buffer_traits<Buffer>,
             typename T = typename Tr::value_type
         >
-        void read_fit(Buffer& buffer)
+        void write_slice(Buffer const& buffer, h5::shape<rank> const& offset)
         {
-            Tr::reshape(buffer, shape());
-            read(Tr::data(buffer), Tr::shape(buffer));
+            write_slice(Tr::data(buffer), offset, Tr::shape(buffer));
         }
 
 
-        // Writes a new dataset of given shape.
-        //
-        // The function writes flattened data pointed-to by `buf` to the path.
-        // It always creates a new dataset, clobbering existing one if any.
-        // Ancestor groups are created if not exist.
+        // Starts incremtnal writing to a new unlimited dataset.
         //
-        // XXX: Current implementation is not exception safe. Old dataset will
-        // be lost if writing a new dataset fails.
+        // If `stream_options.append` is set and the dataset exists, the
+        // function instead resumes appending records to the existing dataset
+        // keeping its chunking and filters. `options` is not used then.
         //
         // Parameters:
-        //   T       = Type of the buffer. This must be compatible with the
-        //             dataset type `D`.
-        //   buf     = Pointer to the buffer.
-        //   shape   = Shape of the buffer.
-        //   options = Options for the newly created dataset.
+        //   record_shape   = Shape of each record in the dataset.
+        //   options        = Options for the newly created dataset.
+        //   stream_options = Options for the returned stream_writer.
         //
-        template<typename T>
-        void write(
-            T const* buf,
-            h5::shape<rank> const& shape,
-            h5::dataset_options const& options
+        h5::stream_writer<D, rank - 1> stream_writer(
+            h5::shape<rank - 1> const& record_shape,
+            h5::dataset_options const& options,
+            h5::stream_options const& stream_options
         )
         {
+            if (stream_options.append && _dataset >= 0) {
+                detail::check_unlimited_dataset(_dataset, record_shape);
+
+                return h5::stream_writer<D, rank - 1>{
+                    _file, _dataset, record_shape, stream_options, _state, _path
+                };
+            }
+
+            detail::notify_modify(_state.get(), _path);
+
             if (detail::check_path_exists(_file, _path)) {
                 if (H5Ldelete(_file, _path.c_str(), H5P_DEFAULT) < 0) {
                     throw h5::exception("failed to delete a path");
@@ -1274,99 +6340,216 @@ namespace h5
             }
 
             _dataset = -1;
-            _dataset = detail::create_simple_dataset<D, rank>(
-                _file, _path, datatype, shape, options
+            _fixed_shape = false;
+            _dataset = detail::create_unlimited_dataset<D>(
+                _file, _path, datatype, record_shape, options, access_props()
             );
 
-            if (detail::is_enum_datatype(datatype)) {
-                detail::write_enum_dataset(_dataset, buf, shape.size(), datatype);
-            } else {
-                detail::write_dataset(_dataset, buf, shape.size());
-            }
+            return h5::stream_writer<D, rank - 1>{
+                _file, _dataset, record_shape, stream_options, _state, _path
+            };
+        }
 
-            if (H5Fflush(_file, H5F_SCOPE_LOCAL) < 0) {
-                throw h5::exception("failed to flush changes to disk");
-            }
+
+        // Calls `stream_writer` with default streaming options.
+        h5::stream_writer<D, rank - 1> stream_writer(
+            h5::shape<rank - 1> const& record_shape,
+            h5::dataset_options const& options
+        )
+        {
+            h5::stream_options default_stream_options;
+            return stream_writer(record_shape, options, default_stream_options);
         }
 
 
-        // Calls `write` with default options.
-        template<typename T>
-        void write(T const* buf, h5::shape<rank> const& shape)
+        // Calls `stream_writer` with default options.
+        h5::stream_writer<D, rank - 1> stream_writer(h5::shape<rank - 1> const& record_shape)
         {
             h5::dataset_options default_options;
-            return write(buf, shape, default_options);
+            return stream_writer(record_shape, default_options);
+        }
+
+
+        // Starts sequential reading of records in the dataset. A record is
+        // a sub-array of the dataset indexed by the first dimension.
+        //
+        // The function throws an `h5::exception` if dataset is not open.
+        //
+        // Parameters:
+        //   options = Streaming options.
+        //
+        h5::stream_reader<D, rank - 1> stream_reader(h5::stream_reader_options const& options)
+        {
+            if (_dataset < 0) {
+                throw h5::exception("dataset is not open");
+            }
+            return h5::stream_reader<D, rank - 1>{_dataset, options};
+        }
+
+
+        // Calls `stream_reader` with default options.
+        h5::stream_reader<D, rank - 1> stream_reader()
+        {
+            h5::stream_reader_options default_options;
+            return stream_reader(default_options);
+        }
+
+
+    private:
+        friend class h5::file;
+
+        // Opens a dataset. Datasets opened with default access options are
+        // looked up in the handle cache of `state` if given.
+        dataset(
+            hid_t file,
+            std::string const& path,
+            h5::dataset_access_options const& access_options,
+            std::shared_ptr<detail::file_state> state
+        )
+            : _file{file}
+            , _path{path}
+            , _access_props{detail::make_dataset_access_props(access_options)}
+            , _state{std::move(state)}
+        {
+            if (_state && _state->caches_datasets() && _access_props < 0) {
+                auto const entry = _state->find_dataset(path);
+                if (entry) {
+                    if (entry->rank != rank) {
+                        throw h5::exception("unexpected dataset rank");
+                    }
+                    detail::check_datatype<D>(entry->datatype);
+
+                    // The cached handle is shared by incrementing its
+                    // reference count. Closing either one decrements it.
+                    if (H5Iinc_ref(entry->dataset) < 0) {
+                        throw h5::exception("failed to share dataset handle");
+                    }
+                    _dataset = hid_t(entry->dataset);
+
+                    if (entry->fixed_shape) {
+                        detail::set_dims(entry->dims, _shape);
+                        _fixed_shape = true;
+                    }
+                }
+                return;
+            }
+
+            if (detail::check_path_exists(file, path)) {
+                _dataset = H5Dopen2(file, path.c_str(), access_props());
+                if (_dataset < 0) {
+                    throw h5::exception("failed to open dataset");
+                }
+
+                detail::check_dataset_rank<rank>(_dataset);
+                detail::check_dataset_type<D>(_dataset);
+            }
         }
 
 
-        // Calls `write` with buffer's underlying pointer.
-        template<
-            typename Buffer,
-            typename Tr = h5::buffer_traits<Buffer>,
-            typename T = typename Tr::value_type
-        >
-        void write(Buffer const& buffer, h5::dataset_options const& options)
+        // Opens an enum dataset.
+        dataset(
+            hid_t file,
+            std::string const& path,
+            h5::enums<D> const& enums,
+            h5::dataset_access_options const& access_options,
+            std::shared_ptr<detail::file_state> state
+        )
+            : dataset{file, path, access_options, std::move(state)}
         {
-            write(Tr::data(buffer), Tr::shape(buffer), options);
+            _given_datatype = detail::make_enum_type(enums);
+
+            if (_dataset >= 0) {
+                detail::check_dataset_enums(_dataset, enums);
+            }
         }
 
 
-        // Calls `write` with buffer's underlying pointer.
-        template<
-            typename Buffer,
-            typename Tr = h5::buffer_traits<Buffer>,
-            typename T = typename Tr::value_type
-        >
-        void write(Buffer const& buffer)
+        // Returns the dataset access props to use.
+        hid_t access_props() const noexcept
         {
-            write(Tr::data(buffer), Tr::shape(buffer));
+            return _access_props >= 0 ? hid_t(_access_props) : H5P_DEFAULT;
         }
 
 
-        // Starts incremtnal writing to a new unlimited dataset.
-        //
-        // Parameters:
-        //   record_shape = Shape of each record in the dataset.
-        //   options      = Options for the newly created dataset.
-        //
-        h5::stream_writer<D, rank - 1> stream_writer(
-            h5::shape<rank - 1> const& record_shape,
-            h5::dataset_options const& options
-        )
+        // Makes `_dataset` a dataset of given shape and options, reusing the
+        // existing one if possible. Returns the datatype of the dataset.
+        hid_t prepare(h5::shape<rank> const& shape, h5::dataset_options const& options)
         {
-            if (detail::check_path_exists(_file, _path)) {
-                if (H5Ldelete(_file, _path.c_str(), H5P_DEFAULT) < 0) {
-                    throw h5::exception("failed to delete a path");
-                }
-            }
-
             hid_t datatype = h5::storage_type<D>();
             if (_given_datatype >= 0) {
                 datatype = _given_datatype;
             }
 
-            _dataset = -1;
-            _dataset = detail::create_unlimited_dataset<D>(
-                _file, _path, datatype, record_shape, options
-            );
+            bool const overwritable = _dataset >= 0 &&
+                detail::is_overwritable<D>(_dataset, datatype, shape, options);
+
+            if (!overwritable) {
+                detail::notify_modify(_state.get(), _path);
+
+                if (detail::check_path_exists(_file, _path)) {
+                    if (H5Ldelete(_file, _path.c_str(), H5P_DEFAULT) < 0) {
+                        throw h5::exception("failed to delete a path");
+                    }
+                }
 
-            return h5::stream_writer<D, rank - 1>{_file, _dataset, record_shape};
+                _dataset = -1;
+                _fixed_shape = false;
+                _dataset = detail::create_simple_dataset<D, rank>(
+                    _file, _path, datatype, shape, options, access_props()
+                );
+                _shape = shape;
+                _fixed_shape = true;
+            }
+
+            return datatype;
         }
 
 
-        // Calls `stream_writer` with default options.
-        h5::stream_writer<D, rank - 1> stream_writer(h5::shape<rank - 1> const& record_shape)
+        // Maps the storage of the dataset into memory.
+        template<typename T>
+        std::shared_ptr<detail::file_mapping> map_storage(bool writable) const
         {
-            h5::dataset_options default_options;
-            return stream_writer(record_shape, default_options);
-        }
+            if (_dataset < 0) {
+                throw h5::exception("dataset is not open");
+            }
 
+            if (writable) {
+                h5::unique_hid<H5Fclose> file = H5Iget_file_id(_dataset);
+                unsigned intent;
+                if (file < 0 || H5Fget_intent(file, &intent) < 0) {
+                    throw h5::exception("failed to get file intent");
+                }
+                if (!(intent & H5F_ACC_RDWR)) {
+                    throw h5::exception("file is not writable");
+                }
+            }
+
+            auto const size = shape().size();
+            auto const offset = detail::get_mappable_offset<T>(_dataset);
+            if (offset == HADDR_UNDEF) {
+                if (size == 0) {
+                    return nullptr;
+                }
+                throw h5::exception("dataset storage is not allocated");
+            }
+
+            return std::make_shared<detail::file_mapping>(
+                _dataset,
+                h5::memory_type<T>(),
+                static_cast<std::size_t>(offset),
+                size,
+                writable
+            );
+        }
 
-    private:
         hid_t _file;
         std::string _path;
+        h5::unique_hid<H5Pclose> _access_props;
         h5::unique_hid<H5Dclose> _dataset;
         h5::unique_hid<H5Tclose> _given_datatype;
+        std::shared_ptr<detail::file_state> _state;
+        h5::shape<rank> _shape;
+        bool _fixed_shape = false;
     };
 
 
@@ -1387,17 +6570,20 @@ namespace h5
         // Make sure `dataset` is destroyed before the file it originates.
         //
         dataset(hid_t file, std::string const& path)
-            : _file{file}, _path{path}
+            : dataset{file, path, h5::dataset_access_options{}}
         {
-            if (detail::check_path_exists(file, path)) {
-                _dataset = H5Dopen2(file, path.c_str(), H5P_DEFAULT);
-                if (_dataset < 0) {
-                    throw h5::exception("failed to open dataset");
-                }
+        }
 
-                detail::check_dataset_rank<0>(_dataset);
-                detail::check_dataset_type<D>(_dataset);
-            }
+
+        // Tries to open a dataset with given access options. The options
+        // are also used for the datasets this object creates.
+        dataset(
+            hid_t file,
+            std::string const& path,
+            h5::dataset_access_options const& access_options
+        )
+            : dataset{file, path, access_options, nullptr}
+        {
         }
 
 
@@ -1407,13 +6593,20 @@ namespace h5
         // additional type check of enum members against dataset if exists.
         //
         dataset(hid_t file, std::string const& path, h5::enums<D> const& enums)
-            : dataset{file, path}
+            : dataset{file, path, enums, h5::dataset_access_options{}}
         {
-            _given_datatype = detail::make_enum_type(enums);
+        }
 
-            if (_dataset >= 0) {
-                detail::check_dataset_enums(_dataset, enums);
-            }
+
+        // Tries to open an enum dataset with given access options.
+        dataset(
+            hid_t file,
+            std::string const& path,
+            h5::enums<D> const& enums,
+            h5::dataset_access_options const& access_options
+        )
+            : dataset{file, path, enums, access_options, nullptr}
+        {
         }
 
 
@@ -1452,8 +6645,10 @@ namespace h5
 
         // Writes a new scalar dataset.
         //
-        // The function always creates a new dataset, clobbering existing one
-        // if any. Ancestor groups are created if not exist.
+        // If the existing dataset has the same datatype, the value is
+        // overwritten in place. Otherwise, a new dataset is created,
+        // clobbering existing one if any. Ancestor groups are created if not
+        // exist.
         //
         // XXX: Current implementation is not exception safe. Old dataset will
         // be lost if writing a new dataset fails.
@@ -1466,53 +6661,538 @@ namespace h5
         template<typename T>
         void write(T const& value)
         {
-            if (detail::check_path_exists(_file, _path)) {
-                if (H5Ldelete(_file, _path.c_str(), H5P_DEFAULT) < 0) {
-                    throw h5::exception("failed to delete a path");
+            hid_t datatype = h5::storage_type<D>();
+            if (_given_datatype >= 0) {
+                datatype = _given_datatype;
+            }
+
+            bool overwritable = false;
+            if (_dataset >= 0) {
+                h5::unique_hid<H5Tclose> dataset_type = H5Dget_type(_dataset);
+                overwritable = dataset_type >= 0 && H5Tequal(dataset_type, datatype) > 0;
+            }
+
+            if (!overwritable) {
+                detail::notify_modify(_state.get(), _path);
+
+                if (detail::check_path_exists(_file, _path)) {
+                    if (H5Ldelete(_file, _path.c_str(), H5P_DEFAULT) < 0) {
+                        throw h5::exception("failed to delete a path");
+                    }
+                }
+
+                _dataset = -1;
+                _dataset = detail::create_scalar_dataset<D>(_file, _path, datatype);
+            }
+
+            if (detail::is_enum_datatype(datatype)) {
+                detail::write_enum_dataset(_dataset, &value, 1, datatype);
+            } else {
+                detail::write_dataset(_dataset, &value, 1);
+            }
+
+            detail::notify_write(_state.get(), _file, _path, sizeof(T));
+        }
+
+
+    private:
+        friend class h5::file;
+
+        // Opens a dataset. Datasets opened with default access options are
+        // looked up in the handle cache of `state` if given.
+        dataset(
+            hid_t file,
+            std::string const& path,
+            h5::dataset_access_options const& access_options,
+            std::shared_ptr<detail::file_state> state
+        )
+            : _file{file}
+            , _path{path}
+            , _access_props{detail::make_dataset_access_props(access_options)}
+            , _state{std::move(state)}
+        {
+            if (_state && _state->caches_datasets() && _access_props < 0) {
+                auto const entry = _state->find_dataset(path);
+                if (entry) {
+                    if (entry->rank != 0) {
+                        throw h5::exception("unexpected dataset rank");
+                    }
+                    detail::check_datatype<D>(entry->datatype);
+
+                    // The cached handle is shared by incrementing its
+                    // reference count. Closing either one decrements it.
+                    if (H5Iinc_ref(entry->dataset) < 0) {
+                        throw h5::exception("failed to share dataset handle");
+                    }
+                    _dataset = hid_t(entry->dataset);
+                }
+                return;
+            }
+
+            if (detail::check_path_exists(file, path)) {
+                _dataset = H5Dopen2(file, path.c_str(), access_props());
+                if (_dataset < 0) {
+                    throw h5::exception("failed to open dataset");
+                }
+
+                detail::check_dataset_rank<0>(_dataset);
+                detail::check_dataset_type<D>(_dataset);
+            }
+        }
+
+
+        // Opens an enum dataset.
+        dataset(
+            hid_t file,
+            std::string const& path,
+            h5::enums<D> const& enums,
+            h5::dataset_access_options const& access_options,
+            std::shared_ptr<detail::file_state> state
+        )
+            : dataset{file, path, access_options, std::move(state)}
+        {
+            _given_datatype = detail::make_enum_type(enums);
+
+            if (_dataset >= 0) {
+                detail::check_dataset_enums(_dataset, enums);
+            }
+        }
+
+
+        // Returns the dataset access props to use.
+        hid_t access_props() const noexcept
+        {
+            return _access_props >= 0 ? hid_t(_access_props) : H5P_DEFAULT;
+        }
+
+        hid_t _file;
+        std::string _path;
+        h5::unique_hid<H5Pclose> _access_props;
+        h5::unique_hid<H5Dclose> _dataset;
+        h5::unique_hid<H5Tclose> _given_datatype;
+        std::shared_ptr<detail::file_state> _state;
+    };
+
+
+    // FILE HANDLING ---------------------------------------------------------
+
+    // File space management strategy. See `H5Pset_file_space_strategy`.
+    enum class file_space_strategy
+    {
+        // Free-space managers with embedded-in-file aggregators. This is the
+        // HDF5 default.
+        fsm_aggr,
+
+        // Paged aggregation: file space is allocated in fixed-size pages.
+        page,
+
+        // Aggregators only. Freed space is not tracked.
+        aggr,
+
+        // No free-space tracking or aggregation.
+        none,
+    };
+
+
+    // Virtual file driver that performs the file I/O.
+    enum class file_driver
+    {
+        // POSIX unbuffered I/O. This is the HDF5 default.
+        sec2,
+
+        // C standard I/O with buffering.
+        stdio,
+
+        // The whole file is held in memory. The file on disk, if any, is
+        // read on open and written on close only with `backing_store`.
+        core,
+
+        // The file is split into members of `family_size` bytes. Filename
+        // must contain a printf-style integer pattern like `%d`.
+        family,
+
+        // Unbuffered I/O bypassing the OS page cache (O_DIRECT). Available
+        // only if HDF5 is built with the direct driver.
+        direct,
+    };
+
+
+    // Optional parameters passed to `h5::file` constructor.
+    struct file_options
+    {
+        // File space management strategy used for a newly created file.
+        //
+        // This and the following creation options are effective only when a
+        // file is created (mode `w` or `w-`). An existing file keeps the
+        // settings it was created with.
+        //
+        detail::optional<h5::file_space_strategy> space_strategy;
+
+        // Persists free-space information across file open/close. Space
+        // freed by replaced or deleted datasets is then reused by later
+        // sessions instead of being lost on close. Requires `fsm_aggr` or
+        // `page` strategy (`fsm_aggr` is used if `space_strategy` is unset).
+        bool persist_free_space = false;
+
+        // Free-space sections smaller than this many bytes are not tracked.
+        detail::optional<std::size_t> free_space_threshold;
+
+        // File space page size in bytes used by the `page` strategy.
+        detail::optional<std::size_t> page_size;
+
+        // Determines when data written through the file is flushed to disk.
+        // The default flushes after every write.
+        h5::flush_policy flush;
+
+        // Maximum number of dataset handles the file keeps open for reuse.
+        // The least recently used handle is closed when the limit is
+        // exceeded. Zero, the default, disables the cache.
+        std::size_t dataset_cache_size = 0;
+
+        // Maintains a catalog of datasets stored in the file at `/.catalog`.
+        // The catalog is loaded with a single read on open, or built by
+        // walking the file if absent or stale, and serves `file::catalog` and
+        // `file::info` without touching dataset metadata. It is updated on
+        // writes through the file and stored on `file::flush` and close.
+        bool catalog = false;
+
+        // Uses this driver when set. The HDF5 default is used otherwise.
+        detail::optional<h5::file_driver> driver;
+
+        // Writes an in-memory file to disk on flush and close. Effective with
+        // the `core` driver.
+        bool backing_store = false;
+
+        // Opens this file image (content of an HDF5 file) in memory instead
+        // of the named file. Implies the `core` driver without backing
+        // store. The mode must be `r` or `r+`; modifications are kept in
+        // memory and can be retrieved by `file::image`.
+        detail::optional<std::vector<unsigned char>> image;
+
+        // Size in bytes of each member file of the `family` driver.
+        std::size_t family_size = std::size_t(1) << 31;
+
+        // Uses the latest file format for new objects. Newer B-tree and
+        // object header formats make large groups and chunk indexes faster,
+        // but the file may not be readable by older HDF5 versions.
+        bool libver_latest = false;
+
+        // Aligns file objects at least `alignment_threshold` bytes large on
+        // multiples of `alignment` bytes, e.g., filesystem stripe or page
+        // boundaries. The default threshold aligns all objects.
+        detail::optional<std::size_t> alignment;
+        std::size_t alignment_threshold = 1;
+
+        // Size in bytes of the sieve buffer that coalesces small raw data
+        // accesses to contiguous datasets. HDF5 default is 64 KiB.
+        detail::optional<std::size_t> sieve_buffer_size;
+
+        // Caches whole file space pages in a buffer of this many bytes. The
+        // file must have been created with the `page` space strategy, and
+        // the size must be a multiple of the page size. Metadata of objects
+        // created together are then read in a few page-sized reads.
+        //
+        // Requires HDF5 1.12 or later. The page buffer of HDF5 1.10.x reads
+        // past heap blocks on some metadata near page boundaries, so opening
+        // a file with this option throws an `h5::exception` there.
+        //
+        detail::optional<std::size_t> page_buffer_size;
+
+        // Minimum percentages of the page buffer reserved for metadata and
+        // raw data pages, respectively.
+        unsigned page_buffer_min_meta = 0;
+        unsigned page_buffer_min_raw = 0;
+
+        // Size in bytes of the blocks from which metadata is allocated.
+        // Larger blocks pack the metadata of many small objects together.
+        // HDF5 default is 2 KiB.
+        detail::optional<std::size_t> metadata_block_size;
+
+        // Saves the metadata cache in the file on close, so that the next
+        // open loads it in one read instead of rebuilding the cache with
+        // many small reads. Effective when the file is written (modes `r+`,
+        // `w` and `w-`). The saved image is loaded on any later open.
+        //
+        // HDF5 writes the image only in the 1.10 file format, so this option
+        // raises the lower library version bound to 1.10 as well.
+        //
+        bool cache_image = false;
+
+        // Initial and maximum size in bytes of the metadata cache. HDF5
+        // default is 2 MiB and 32 MiB, respectively. The cache resizes
+        // itself between its minimum and maximum size.
+        detail::optional<std::size_t> metadata_cache_size;
+        detail::optional<std::size_t> metadata_cache_max_size;
+    };
+
+
+    namespace detail
+    {
+        // Returns true if any file creation option is set.
+        inline bool has_creation_options(h5::file_options const& options)
+        {
+            return options.space_strategy
+                || options.persist_free_space
+                || options.free_space_threshold
+                || options.page_size;
+        }
+
+
+        // Creates file creation props from options.
+        inline
+        h5::unique_hid<H5Pclose>
+        make_file_creation_props(h5::file_options const& options)
+        {
+            h5::unique_hid<H5Pclose> file_props = H5Pcreate(H5P_FILE_CREATE);
+            if (file_props < 0) {
+                throw h5::exception("failed to create file props");
+            }
+
+            if (!detail::has_creation_options(options)) {
+                return file_props;
+            }
+
+#if H5_VERSION_GE(1, 10, 1)
+            H5F_fspace_strategy_t strategy;
+            hbool_t persist;
+            hsize_t threshold;
+            if (H5Pget_file_space_strategy(file_props, &strategy, &persist, &threshold) < 0) {
+                throw h5::exception("failed to get file space strategy");
+            }
+
+            if (options.space_strategy) {
+                switch (*options.space_strategy) {
+                case h5::file_space_strategy::fsm_aggr:
+                    strategy = H5F_FSPACE_STRATEGY_FSM_AGGR;
+                    break;
+                case h5::file_space_strategy::page:
+                    strategy = H5F_FSPACE_STRATEGY_PAGE;
+                    break;
+                case h5::file_space_strategy::aggr:
+                    strategy = H5F_FSPACE_STRATEGY_AGGR;
+                    break;
+                case h5::file_space_strategy::none:
+                    strategy = H5F_FSPACE_STRATEGY_NONE;
+                    break;
+                }
+            }
+
+            persist = options.persist_free_space;
+
+            if (options.free_space_threshold) {
+                threshold = static_cast<hsize_t>(*options.free_space_threshold);
+            }
+
+            if (H5Pset_file_space_strategy(file_props, strategy, persist, threshold) < 0) {
+                throw h5::exception("failed to set file space strategy");
+            }
+
+            if (options.page_size) {
+                auto const page_size = static_cast<hsize_t>(*options.page_size);
+                if (H5Pset_file_space_page_size(file_props, page_size) < 0) {
+                    throw h5::exception("failed to set file space page size");
+                }
+            }
+#else
+            throw h5::exception("file space options require HDF5 1.10.1 or later");
+#endif
+
+            return file_props;
+        }
+
+
+        // Creates file access props from options.
+        inline
+        h5::unique_hid<H5Pclose>
+        make_file_access_props(h5::file_options const& options)
+        {
+            constexpr std::size_t core_increment = 1024 * 1024;
+#ifdef H5_HAVE_DIRECT
+            constexpr std::size_t direct_alignment = 4096;
+            constexpr std::size_t direct_buffer_size = 16 * 1024 * 1024;
+#endif
+
+            h5::unique_hid<H5Pclose> access_props = H5Pcreate(H5P_FILE_ACCESS);
+            if (access_props < 0) {
+                throw h5::exception("failed to create file access props");
+            }
+
+            auto driver = options.driver;
+            if (options.image) {
+                driver = h5::file_driver::core;
+            }
+
+            if (driver) {
+                herr_t status = 0;
+
+                switch (*driver) {
+                case h5::file_driver::sec2:
+                    status = H5Pset_fapl_sec2(access_props);
+                    break;
+
+                case h5::file_driver::stdio:
+                    status = H5Pset_fapl_stdio(access_props);
+                    break;
+
+                case h5::file_driver::core:
+                    status = H5Pset_fapl_core(
+                        access_props, core_increment, options.backing_store && !options.image
+                    );
+                    break;
+
+                case h5::file_driver::family:
+                    status = H5Pset_fapl_family(
+                        access_props, static_cast<hsize_t>(options.family_size), H5P_DEFAULT
+                    );
+                    break;
+
+                case h5::file_driver::direct:
+#ifdef H5_HAVE_DIRECT
+                    status = H5Pset_fapl_direct(
+                        access_props, direct_alignment, direct_alignment, direct_buffer_size
+                    );
+                    break;
+#else
+                    throw h5::exception("direct driver is not available");
+#endif
+                }
+
+                if (status < 0) {
+                    throw h5::exception("failed to set file driver");
+                }
+            }
+
+            if (options.image) {
+                // HDF5 copies the image, so it is not modified.
+                auto& image = *options.image;
+                if (H5Pset_file_image(access_props, image.data(), image.size()) < 0) {
+                    throw h5::exception("failed to set file image");
+                }
+            }
+
+            if (options.libver_latest) {
+                if (H5Pset_libver_bounds(access_props, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST) < 0) {
+                    throw h5::exception("failed to set library version bounds");
+                }
+            }
+
+            if (options.alignment) {
+                auto const status = H5Pset_alignment(
+                    access_props,
+                    static_cast<hsize_t>(options.alignment_threshold),
+                    static_cast<hsize_t>(*options.alignment)
+                );
+                if (status < 0) {
+                    throw h5::exception("failed to set alignment");
+                }
+            }
+
+            if (options.sieve_buffer_size) {
+                if (H5Pset_sieve_buf_size(access_props, *options.sieve_buffer_size) < 0) {
+                    throw h5::exception("failed to set sieve buffer size");
+                }
+            }
+
+            if (options.page_buffer_size) {
+#if H5_VERSION_GE(1, 12, 0)
+                auto const status = H5Pset_page_buffer_size(
+                    access_props,
+                    *options.page_buffer_size,
+                    options.page_buffer_min_meta,
+                    options.page_buffer_min_raw
+                );
+                if (status < 0) {
+                    throw h5::exception("failed to set page buffer size");
                 }
+#else
+                throw h5::exception("page buffer requires HDF5 1.12 or later");
+#endif
             }
 
-            hid_t datatype = h5::storage_type<D>();
-            if (_given_datatype >= 0) {
-                datatype = _given_datatype;
+            if (options.metadata_block_size) {
+                auto const size = static_cast<hsize_t>(*options.metadata_block_size);
+                if (H5Pset_meta_block_size(access_props, size) < 0) {
+                    throw h5::exception("failed to set metadata block size");
+                }
             }
 
-            _dataset = -1;
-            _dataset = detail::create_scalar_dataset<D>(_file, _path, datatype);
+            if (options.cache_image) {
+#if H5_VERSION_GE(1, 10, 1)
+                H5AC_cache_image_config_t config;
+                config.version = H5AC__CURR_CACHE_IMAGE_CONFIG_VERSION;
+                config.generate_image = true;
+                config.save_resize_status = false;
+                config.entry_ageout = H5AC__CACHE_IMAGE__ENTRY_AGEOUT__NONE;
 
-            if (detail::is_enum_datatype(datatype)) {
-                detail::write_enum_dataset(_dataset, &value, 1, datatype);
-            } else {
-                detail::write_dataset(_dataset, &value, 1);
-            }
+                if (H5Pset_mdc_image_config(access_props, &config) < 0) {
+                    throw h5::exception("failed to set metadata cache image config");
+                }
 
-            if (H5Fflush(_file, H5F_SCOPE_LOCAL) < 0) {
-                throw h5::exception("failed to flush changes to disk");
+                // HDF5 silently skips the image with older format bounds.
+                if (!options.libver_latest) {
+#if H5_VERSION_GE(1, 10, 2)
+                    auto const status = H5Pset_libver_bounds(
+                        access_props, H5F_LIBVER_V110, H5F_LIBVER_LATEST
+                    );
+#else
+                    auto const status = H5Pset_libver_bounds(
+                        access_props, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST
+                    );
+#endif
+                    if (status < 0) {
+                        throw h5::exception("failed to set library version bounds");
+                    }
+                }
+#else
+                throw h5::exception("cache image requires HDF5 1.10.1 or later");
+#endif
             }
-        }
 
+            if (options.metadata_cache_size || options.metadata_cache_max_size) {
+                H5AC_cache_config_t config;
+                config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+                if (H5Pget_mdc_config(access_props, &config) < 0) {
+                    throw h5::exception("failed to get metadata cache config");
+                }
 
-    private:
-        hid_t _file;
-        std::string _path;
-        h5::unique_hid<H5Dclose> _dataset;
-        h5::unique_hid<H5Tclose> _given_datatype;
-    };
+                if (options.metadata_cache_max_size) {
+                    config.max_size = *options.metadata_cache_max_size;
+                }
+                if (options.metadata_cache_size) {
+                    config.set_initial_size = true;
+                    config.initial_size = *options.metadata_cache_size;
+                    config.max_size = std::max(config.max_size, config.initial_size);
+                }
+                config.min_size = std::min(config.min_size, config.max_size);
+                if (config.set_initial_size) {
+                    config.initial_size = std::min(config.initial_size, config.max_size);
+                    config.initial_size = std::max(config.initial_size, config.min_size);
+                }
 
+                if (H5Pset_mdc_config(access_props, &config) < 0) {
+                    throw h5::exception("failed to set metadata cache config");
+                }
+            }
+
+            return access_props;
+        }
 
-    // FILE HANDLING ---------------------------------------------------------
 
-    namespace detail
-    {
         // Opens an existing HDF5 file.
         inline
         h5::unique_hid<H5Fclose>
-        do_open_file(std::string const& filename, bool readonly)
+        do_open_file(
+            std::string const& filename,
+            bool readonly,
+            h5::file_options const& options
+        )
         {
+            auto const access_props = detail::make_file_access_props(options);
+
             h5::unique_hid<H5Fclose> file = H5Fopen(
                 filename.c_str(),
                 readonly ? H5F_ACC_RDONLY : H5F_ACC_RDWR,
-                H5P_DEFAULT
+                access_props
             );
             if (file < 0) {
                 throw h5::exception("cannot open file");
@@ -1524,13 +7204,24 @@ namespace h5
         // Creates an empty HDF5 file.
         inline
         h5::unique_hid<H5Fclose>
-        do_create_file(std::string const& filename, bool truncate)
+        do_create_file(
+            std::string const& filename,
+            bool truncate,
+            h5::file_options const& options
+        )
         {
+            if (options.image) {
+                throw h5::exception("file image can only be opened with mode r or r+");
+            }
+
+            auto const file_props = detail::make_file_creation_props(options);
+            auto const access_props = detail::make_file_access_props(options);
+
             h5::unique_hid<H5Fclose> file = H5Fcreate(
                 filename.c_str(),
                 truncate ? H5F_ACC_TRUNC : H5F_ACC_EXCL,
-                H5P_DEFAULT,
-                H5P_DEFAULT
+                file_props,
+                access_props
             );
             if (file < 0) {
                 throw h5::exception("cannot create file");
@@ -1542,19 +7233,23 @@ namespace h5
         // Opens or creates an HDF5 file based on given mode string.
         inline
         h5::unique_hid<H5Fclose>
-        open_file(std::string const& filename, std::string const& mode)
+        open_file(
+            std::string const& filename,
+            std::string const& mode,
+            h5::file_options const& options
+        )
         {
             if (mode == "r") {
-                return detail::do_open_file(filename, true);
+                return detail::do_open_file(filename, true, options);
             }
             if (mode == "r+") {
-                return detail::do_open_file(filename, false);
+                return detail::do_open_file(filename, false, options);
             }
             if (mode == "w") {
-                return detail::do_create_file(filename, true);
+                return detail::do_create_file(filename, true, options);
             }
             if (mode == "w-") {
-                return detail::do_create_file(filename, false);
+                return detail::do_create_file(filename, false, options);
             }
             throw h5::exception("unrecognized file mode");
         }
@@ -1578,8 +7273,52 @@ namespace h5
         // | w-   | Read-write. File must not exist.          |
         //
         file(std::string const& filename, std::string const& mode)
-            : _file{detail::open_file(filename, mode)}
+            : file{filename, mode, h5::file_options{}}
+        {
+        }
+
+
+        // Opens or creates an HDF5 file with given options.
+        //
+        // Parameters:
+        //   filename = Path to the HDF5 file.
+        //   mode     = One of these four strings: r, r+, w or w-.
+        //   options  = Options for the file. Creation options are applied
+        //              only when a new file is created.
+        //
+        file(
+            std::string const& filename,
+            std::string const& mode,
+            h5::file_options const& options
+        )
+            : _file{detail::open_file(filename, mode, options)}
+            , _state{std::make_shared<detail::file_state>(
+                _file, options.flush, options.dataset_cache_size
+            )}
+        {
+            _state->open_catalog(options.catalog);
+        }
+
+        // Destructor stores the catalog if it is modified. Errors are
+        // silently ignored; call `flush` to detect them. The file stays open
+        // while datasets opened from it are alive.
+        ~file() noexcept
+        {
+            close();
+        }
+
+        file(file&&) = default;
+
+        // Move assignment closes the file being replaced as the destructor
+        // does, and then takes over the other file.
+        file& operator=(file&& other) noexcept
         {
+            if (this != &other) {
+                close();
+                _file = std::move(other._file);
+                _state = std::move(other._state);
+            }
+            return *this;
         }
 
 
@@ -1599,6 +7338,7 @@ namespace h5
         //   path  = HDF5 dataset path.
         //   enums = Assume the dataset to hold enumerated values defined in
         //           this list.
+        //   access_options = Chunk cache settings for the dataset.
         //
         // Returns:
         //   `h5::dataset` object.
@@ -1606,18 +7346,492 @@ namespace h5
         template<typename D, int rank = 0>
         h5::dataset<D, rank> dataset(std::string const& path)
         {
-            return h5::dataset<D, rank>{_file, path};
+            return dataset<D, rank>(path, h5::dataset_access_options{});
         }
 
         template<typename D, int rank = 0>
         h5::dataset<D, rank> dataset(std::string const& path, h5::enums<D> const& enums)
         {
-            return h5::dataset<D, rank>{_file, path, enums};
+            return dataset<D, rank>(path, enums, h5::dataset_access_options{});
+        }
+
+        template<typename D, int rank = 0>
+        h5::dataset<D, rank> dataset(
+            std::string const& path,
+            h5::dataset_access_options const& access_options
+        )
+        {
+            return h5::dataset<D, rank>{_file, path, access_options, _state};
+        }
+
+        template<typename D, int rank = 0>
+        h5::dataset<D, rank> dataset(
+            std::string const& path,
+            h5::enums<D> const& enums,
+            h5::dataset_access_options const& access_options
+        )
+        {
+            return h5::dataset<D, rank>{_file, path, enums, access_options, _state};
+        }
+
+
+        // Flushes written data and the catalog to disk regardless of the
+        // flush policy.
+        void flush()
+        {
+            _state->store_catalog();
+            _state->flush();
+        }
+
+
+        // Returns the content of the file as a byte buffer.
+        //
+        // The image can be written to disk as a valid HDF5 file, or opened
+        // in memory by passing it as `file_options::image`. This works with
+        // any driver, but is most useful with the `core` driver where the
+        // file never touches disk.
+        //
+        std::vector<unsigned char> image()
+        {
+            _state->store_catalog();
+
+            if (H5Fflush(_file, H5F_SCOPE_LOCAL) < 0) {
+                throw h5::exception("failed to flush file");
+            }
+
+            auto const size = H5Fget_file_image(_file, nullptr, 0);
+            if (size < 0) {
+                throw h5::exception("failed to get file image size");
+            }
+
+            std::vector<unsigned char> image(static_cast<std::size_t>(size));
+            if (H5Fget_file_image(_file, image.data(), image.size()) < 0) {
+                throw h5::exception("failed to get file image");
+            }
+            return image;
+        }
+
+        // Lists objects in a group.
+        //
+        // Parameters:
+        //   group   = HDF5 group path.
+        //   options = Whether to list recursively and whether to retrieve
+        //             dataset shapes and types.
+        //
+        // Returns:
+        //   Objects in the creation order if the group tracks it, or in the
+        //   name order. Paths are relative to `group`. Soft and external
+        //   links are not followed and listed as `object_type::other`.
+        //
+        std::vector<h5::object_info> list(
+            std::string const& group = "/",
+            h5::list_options const& options = {}
+        ) const
+        {
+            return detail::list_group(_file, group, options);
+        }
+
+
+        // Lists objects in a group lazily, calling `fn(info)` with each
+        // `h5::object_info` as its link is read instead of collecting them.
+        // Objects come in the same order as `list` returns them: with
+        // `recursive` set, each subgroup is followed by its contents. An
+        // exception thrown by `fn` stops the listing and propagates.
+        //
+        // Parameters:
+        //   group   = HDF5 group path.
+        //   options = Whether to list recursively and whether to retrieve
+        //             dataset shapes and types.
+        //   fn      = Function called with each object.
+        //
+        template<typename F>
+        void visit(std::string const& group, h5::list_options const& options, F fn) const
+        {
+            detail::visit_objects(_file, group, options, [&](h5::object_info&& info) {
+                fn(std::move(info));
+            });
+        }
+
+
+        // Describes the object at `path`, retrieving the dataset shape and
+        // type if it is a dataset. Datasets are looked up in the catalog if
+        // it is enabled.
+        h5::object_info info(std::string const& path) const
+        {
+            if (_state->has_catalog()) {
+                if (auto const entry = _state->find_catalog(path)) {
+                    return *entry;
+                }
+            }
+
+            if (detail::is_catalog_path(path) || !detail::check_path_exists(_file, path)) {
+                throw h5::exception("object does not exist");
+            }
+
+            detail::link_info link;
+#if H5_VERSION_GE(1, 12, 0)
+            auto const status = H5Lget_info2(_file, path.c_str(), &link, H5P_DEFAULT);
+#else
+            auto const status = H5Lget_info(_file, path.c_str(), &link, H5P_DEFAULT);
+#endif
+            if (status < 0) {
+                throw h5::exception("failed to get link info");
+            }
+            return detail::describe_object(_file, path.c_str(), link.type, true);
+        }
+
+
+        // Returns all datasets in the file sorted by path. Paths are relative
+        // to the root group. Requires `file_options::catalog`.
+        std::vector<h5::object_info> catalog() const
+        {
+            if (!_state->has_catalog()) {
+                throw h5::exception("catalog is not enabled");
+            }
+
+            std::vector<h5::object_info> entries;
+            for (auto const entry : _state->catalog_entries()) {
+                entries.push_back(*entry);
+            }
+            return entries;
+        }
+
+    private:
+        void close() noexcept
+        {
+            if (!_state) {
+                return;
+            }
+            try {
+                _state->store_catalog();
+            } catch (...) {
+            }
         }
 
     private:
         h5::unique_hid<H5Fclose> _file;
+        std::shared_ptr<detail::file_state> _state;
     };
+
+
+#ifdef SNSINFU_H5_HAS_FORK
+    namespace detail
+    {
+        // Appends the bytes of a trivially copyable value to a message.
+        template<typename T>
+        void put_message(std::string& message, T value)
+        {
+            message.append(reinterpret_cast<char const*>(&value), sizeof value);
+        }
+
+
+        inline void put_message(std::string& message, std::string const& str)
+        {
+            detail::put_message(message, std::uint64_t(str.size()));
+            message += str;
+        }
+
+
+        // Reads values appended by `put_message` in the same order.
+        class message_reader
+        {
+        public:
+            explicit message_reader(std::string const& message)
+                : _message{message}
+            {
+            }
+
+            template<typename T>
+            T get()
+            {
+                T value;
+                std::memcpy(&value, take(sizeof value), sizeof value);
+                return value;
+            }
+
+            std::string get_string()
+            {
+                auto const size = static_cast<std::size_t>(get<std::uint64_t>());
+                return std::string(take(size), size);
+            }
+
+        private:
+            char const* take(std::size_t size)
+            {
+                if (size > _message.size() - _offset) {
+                    throw h5::exception("truncated scan result");
+                }
+                auto const data = _message.data() + _offset;
+                _offset += size;
+                return data;
+            }
+
+        private:
+            std::string const& _message;
+            std::size_t _offset = 0;
+        };
+
+
+        // Encodes the listing of a file, or the error that stopped it, to
+        // pass it from a scanning process.
+        inline std::string encode_listing(std::vector<h5::object_info> const& objects)
+        {
+            std::string message;
+            detail::put_message(message, std::uint8_t(0));
+            detail::put_message(message, std::uint64_t(objects.size()));
+
+            for (auto const& info : objects) {
+                detail::put_message(message, info.path);
+                detail::put_message(message, info.type);
+                detail::put_message(message, info.rank);
+                detail::put_message(message, std::uint64_t(info.shape.size()));
+                for (auto const dim : info.shape) {
+                    detail::put_message(message, std::uint64_t(dim));
+                }
+                detail::put_message(message, info.value_class);
+                detail::put_message(message, std::uint64_t(info.value_size));
+                detail::put_message(message, std::uint64_t(info.storage_size));
+            }
+            return message;
+        }
+
+
+        inline std::string encode_scan_error(std::string const& what)
+        {
+            std::string message;
+            detail::put_message(message, std::uint8_t(1));
+            detail::put_message(message, what);
+            return message;
+        }
+
+
+        // Decodes a message made by `encode_listing`. Throws the error if the
+        // message carries one.
+        inline std::vector<h5::object_info> decode_listing(std::string const& message)
+        {
+            detail::message_reader reader{message};
+            if (reader.get<std::uint8_t>() != 0) {
+                throw h5::exception(reader.get_string());
+            }
+
+            std::vector<h5::object_info> objects(
+                static_cast<std::size_t>(reader.get<std::uint64_t>())
+            );
+            for (auto& info : objects) {
+                info.path = reader.get_string();
+                info.type = reader.get<h5::object_type>();
+                info.rank = reader.get<int>();
+                info.shape.resize(static_cast<std::size_t>(reader.get<std::uint64_t>()));
+                for (auto& dim : info.shape) {
+                    dim = static_cast<std::size_t>(reader.get<std::uint64_t>());
+                }
+                info.value_class = reader.get<h5::type_class>();
+                info.value_size = static_cast<std::size_t>(reader.get<std::uint64_t>());
+                info.storage_size = static_cast<std::size_t>(reader.get<std::uint64_t>());
+            }
+            return objects;
+        }
+
+
+        inline std::string scan_file(std::string const& filename, h5::list_options const& options)
+        {
+            try {
+                h5::file file{filename, "r"};
+                return detail::encode_listing(file.list("/", options));
+            } catch (std::exception const& e) {
+                return detail::encode_scan_error(e.what());
+            } catch (...) {
+                return detail::encode_scan_error("failed to scan file");
+            }
+        }
+
+
+        // Child process listing a file. The listing is read from a pipe. A
+        // process still running on destruction is killed.
+        class scan_process
+        {
+        public:
+            scan_process(std::string const& filename, h5::list_options const& options)
+                : _filename{filename}
+            {
+                int fds[2];
+                if (::pipe(fds) == -1) {
+                    throw h5::exception("failed to create pipe");
+                }
+
+                _pid = ::fork();
+                if (_pid == -1) {
+                    ::close(fds[0]);
+                    ::close(fds[1]);
+                    throw h5::exception("failed to start scanning process");
+                }
+
+                if (_pid == 0) {
+                    ::close(fds[0]);
+                    auto const message = detail::scan_file(filename, options);
+                    for (std::size_t offset = 0; offset < message.size(); ) {
+                        auto const n = ::write(fds[1], message.data() + offset, message.size() - offset);
+                        if (n == -1 && errno == EINTR) {
+                            continue;
+                        }
+                        if (n == -1) {
+                            ::_exit(1);
+                        }
+                        offset += static_cast<std::size_t>(n);
+                    }
+                    ::_exit(0);
+                }
+
+                ::close(fds[1]);
+                _fd = fds[0];
+            }
+
+            ~scan_process()
+            {
+                if (_fd != -1) {
+                    ::close(_fd);
+                }
+                if (_pid > 0) {
+                    ::kill(_pid, SIGKILL);
+                    reap();
+                }
+            }
+
+            scan_process(scan_process const&) = delete;
+            scan_process& operator=(scan_process const&) = delete;
+
+            std::string const& filename() const
+            {
+                return _filename;
+            }
+
+            int fd() const
+            {
+                return _fd;
+            }
+
+            // Reads available output. Returns true when the output ends.
+            bool read()
+            {
+                char chunk[4096];
+                auto const n = ::read(_fd, chunk, sizeof chunk);
+                if (n == -1 && errno == EINTR) {
+                    return false;
+                }
+                if (n == -1) {
+                    throw h5::exception("failed to read scan result");
+                }
+                _message.append(chunk, static_cast<std::size_t>(n));
+                return n == 0;
+            }
+
+            // Waits for the process to exit and returns the listing.
+            std::vector<h5::object_info> finish()
+            {
+                ::close(_fd);
+                _fd = -1;
+
+                auto const status = reap();
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    throw h5::exception("scanning process failed");
+                }
+                return detail::decode_listing(_message);
+            }
+
+        private:
+            int reap()
+            {
+                int status = 0;
+                while (::waitpid(_pid, &status, 0) == -1 && errno == EINTR) {
+                }
+                _pid = -1;
+                return status;
+            }
+
+        private:
+            std::string _filename;
+            pid_t _pid = -1;
+            int _fd = -1;
+            std::string _message;
+        };
+    }
+#endif
+
+
+    // Lists objects in many files using one worker process per file.
+    //
+    // libhdf5 serializes its calls within a process, even if built
+    // thread-safe, so files cannot be listed concurrently by threads. Each
+    // file is instead opened read-only and listed from the root group in a
+    // child process, with up to `processes` children running at a time. The
+    // listings are passed back through pipes and `fn(filename, objects)` is
+    // called on the calling thread with the filename and a
+    // `std::vector<h5::object_info>`, in the order the listings complete.
+    // `fn` may use HDF5. Other threads must not be calling HDF5 during the
+    // scan, since children are forked with the library state of the moment.
+    // An exception thrown by opening, listing or `fn` stops the scan, kills
+    // running children and propagates. On platforms without `fork` the
+    // files are listed one by one in the calling process.
+    //
+    // Parameters:
+    //   filenames = Paths to HDF5 files.
+    //   options   = Options passed to `file::list`.
+    //   fn        = Function called with the listing of each file.
+    //   processes = Maximum number of worker processes. 0 uses the number of
+    //               hardware threads.
+    //
+    template<typename F>
+    void scan_files(
+        std::vector<std::string> const& filenames,
+        h5::list_options const& options,
+        F fn,
+        unsigned processes = 0
+    )
+    {
+#ifdef SNSINFU_H5_HAS_FORK
+        if (processes == 0) {
+            processes = std::max(std::thread::hardware_concurrency(), 1U);
+        }
+
+        std::vector<std::unique_ptr<detail::scan_process>> running;
+        std::vector<pollfd> poll_fds;
+        auto next = filenames.begin();
+
+        while (next != filenames.end() || !running.empty()) {
+            while (next != filenames.end() && running.size() < processes) {
+                running.push_back(std::make_unique<detail::scan_process>(*next, options));
+                ++next;
+            }
+
+            poll_fds.clear();
+            for (auto const& process : running) {
+                poll_fds.push_back({process->fd(), POLLIN, 0});
+            }
+            if (::poll(poll_fds.data(), poll_fds.size(), -1) == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw h5::exception("failed to wait for scanning processes");
+            }
+
+            for (std::size_t i = poll_fds.size(); i-- > 0; ) {
+                if (poll_fds[i].revents == 0 || !running[i]->read()) {
+                    continue;
+                }
+                auto process = std::move(running[i]);
+                running.erase(running.begin() + static_cast<std::ptrdiff_t>(i));
+                fn(process->filename(), process->finish());
+            }
+        }
+#else
+        (void) processes;
+
+        for (auto const& filename : filenames) {
+            h5::file file{filename, "r"};
+            fn(filename, file.list("/", options));
+        }
+#endif
+    }
 }
 
 #endif
@@ -201,6 +201,85 @@ TEST_CASE("dataset::write - replaces existing dataset")
     CHECK(dataset.shape() == shape);
 }
 
+TEST_CASE("dataset::write - overwrites matching dataset in place")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    h5::dataset_options options;
+    options.compression = 4;
+
+    h5::shape<2> const shape = {100, 20};
+    std::vector<int> data(shape.size(), 1);
+
+    auto dataset = file.dataset<int, 2>("data");
+    dataset.write(data.data(), shape, options);
+
+    // Another handle to the same dataset observes in-place overwrites.
+    auto observer = file.dataset<int, 2>("data");
+
+    SECTION("same shape and options")
+    {
+        std::fill(data.begin(), data.end(), 2);
+        dataset.write(data.data(), shape, options);
+
+        std::vector<int> buf(shape.size());
+        observer.read(buf.data(), shape);
+        CHECK(buf == data);
+    }
+
+    SECTION("different options")
+    {
+        std::fill(data.begin(), data.end(), 2);
+        dataset.write(data.data(), shape);
+
+        // The old dataset has been unlinked and replaced.
+        std::vector<int> buf(shape.size());
+        observer.read(buf.data(), shape);
+        CHECK(buf == std::vector<int>(shape.size(), 1));
+
+        file.dataset<int, 2>("data").read(buf.data(), shape);
+        CHECK(buf == data);
+    }
+
+    SECTION("different shape")
+    {
+        h5::shape<2> const new_shape = {20, 100};
+        dataset.write(data.data(), new_shape, options);
+
+        CHECK(dataset.shape() == new_shape);
+        CHECK(observer.shape() == shape);
+    }
+}
+
+TEST_CASE("dataset::write - does not grow file on repeated overwrites")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    h5::shape<2> const shape = {1000, 100};
+    std::vector<double> data(shape.size());
+
+    auto dataset = file.dataset<double, 2>("data");
+    dataset.write(data.data(), shape);
+
+    hsize_t initial_size;
+    REQUIRE(H5Fget_filesize(file.handle(), &initial_size) >= 0);
+
+    for (int i = 0; i < 10; i++) {
+        std::fill(data.begin(), data.end(), i);
+        dataset.write(data.data(), shape);
+    }
+
+    hsize_t final_size;
+    REQUIRE(H5Fget_filesize(file.handle(), &final_size) >= 0);
+    CHECK(final_size == initial_size);
+
+    double value;
+    file.dataset<double, 2>("data").read_slice(&value, {999, 99}, {1, 1});
+    CHECK(value == 9);
+}
+
 TEST_CASE("dataset::write - applies compression")
 {
     // Write large-ish data with and without compression.
@@ -279,6 +358,486 @@ TEST_CASE("dataset::write - applies compression")
     }
 }
 
+TEST_CASE("dataset::write - compresses chunks in parallel")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    // Odd shape for partial edge chunks.
+    h5::shape<3> const shape = {1001, 37, 3};
+
+    std::vector<double> data;
+    std::mt19937 random;
+    std::generate_n(
+        std::back_inserter(data),
+        shape.size(),
+        [&] {
+            std::uniform_int_distribution<int> uniform{0, 100};
+            return uniform(random);
+        }
+    );
+
+    h5::dataset_options options;
+    options.compression = 4;
+    options.threads = 3;
+
+    SECTION("same type")
+    {
+        auto dataset = file.dataset<double, 3>("data");
+        dataset.write(data.data(), shape, options);
+
+        std::vector<double> buf(shape.size());
+        file.dataset<double, 3>("data").read(buf.data(), shape);
+        CHECK(buf == data);
+    }
+
+    SECTION("converted type")
+    {
+        auto dataset = file.dataset<int, 3>("data");
+        dataset.write(data.data(), shape, options);
+
+        std::vector<double> buf(shape.size());
+        file.dataset<int, 3>("data").read(buf.data(), shape);
+        CHECK(buf == data);
+    }
+
+    SECTION("same size as serial compression")
+    {
+        h5::dataset_options serial_options;
+        serial_options.compression = 4;
+
+        file.dataset<double, 3>("serial").write(data.data(), shape, serial_options);
+        file.dataset<double, 3>("parallel").write(data.data(), shape, options);
+
+        auto const serial_size = H5Dget_storage_size(file.dataset<double, 3>("serial").handle());
+        auto const parallel_size = H5Dget_storage_size(file.dataset<double, 3>("parallel").handle());
+        CHECK(parallel_size == serial_size);
+    }
+
+    SECTION("unsupported filter")
+    {
+        options.scaleoffset = 0;
+
+        auto dataset = file.dataset<double, 3>("data");
+        dataset.write(data.data(), shape, options);
+
+        std::vector<double> buf(shape.size());
+        file.dataset<double, 3>("data").read(buf.data(), shape);
+        CHECK(buf == data);
+    }
+}
+
+TEST_CASE("dataset::read - decompresses chunks in parallel")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    h5::shape<3> const shape = {1001, 37, 3};
+
+    std::vector<float> data;
+    std::mt19937 random;
+    std::generate_n(
+        std::back_inserter(data),
+        shape.size(),
+        [&] {
+            std::uniform_int_distribution<int> uniform{0, 100};
+            return float(uniform(random));
+        }
+    );
+
+    h5::read_options read_options;
+    read_options.threads = 3;
+
+    SECTION("deflate")
+    {
+        h5::dataset_options options;
+        options.compression = 4;
+        file.dataset<float, 3>("data").write(data.data(), shape, options);
+
+        std::vector<float> buf(shape.size());
+        file.dataset<float, 3>("data").read(buf.data(), shape, read_options);
+        CHECK(buf == data);
+    }
+
+    SECTION("unsupported filter")
+    {
+        h5::dataset_options options;
+        options.scaleoffset = 0;
+        file.dataset<float, 3>("data").write(data.data(), shape, options);
+
+        std::vector<float> buf(shape.size());
+        file.dataset<float, 3>("data").read(buf.data(), shape, read_options);
+        CHECK(buf == data);
+    }
+
+    SECTION("converted type")
+    {
+        h5::dataset_options options;
+        options.compression = 4;
+        file.dataset<float, 3>("data").write(data.data(), shape, options);
+
+        std::vector<double> buf(shape.size());
+        file.dataset<float, 3>("data").read(buf.data(), shape, read_options);
+        CHECK(std::equal(buf.begin(), buf.end(), data.begin()));
+    }
+
+    SECTION("contiguous")
+    {
+        file.dataset<float, 3>("data").write(data.data(), shape);
+
+        std::vector<float> buf(shape.size());
+        file.dataset<float, 3>("data").read(buf.data(), shape, read_options);
+        CHECK(buf == data);
+    }
+}
+
+TEST_CASE("dataset - applies chunk cache access options")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    auto access_options = h5::dataset_access_options::for_chunks(4096, 10);
+    access_options.cache_w0 = 1.0;
+
+    CHECK(*access_options.cache_bytes == 40960);
+    CHECK(*access_options.cache_slots == 1009);
+
+    auto check_cache = [&](hid_t dataset) {
+        h5::unique_hid<H5Pclose> access_props = H5Dget_access_plist(dataset);
+        REQUIRE(access_props >= 0);
+
+        std::size_t slots;
+        std::size_t bytes;
+        double w0;
+        REQUIRE(H5Pget_chunk_cache(access_props, &slots, &bytes, &w0) >= 0);
+        CHECK(slots == 1009);
+        CHECK(bytes == 40960);
+        CHECK(w0 == 1.0);
+    };
+
+    h5::dataset_options options;
+    options.compression = 1;
+    std::vector<int> data(1000 * 100);
+
+    SECTION("created and reopened dataset")
+    {
+        auto dataset = file.dataset<int, 2>("data", access_options);
+        dataset.write(data.data(), {1000, 100}, options);
+        check_cache(dataset.handle());
+
+        auto reopened = file.dataset<int, 2>("data", access_options);
+        check_cache(reopened.handle());
+        CHECK(reopened.chunk_shape().size() > 0);
+    }
+
+    SECTION("streamed dataset")
+    {
+        auto dataset = file.dataset<int, 2>("data", access_options);
+        auto stream = dataset.stream_writer({100}, options);
+        check_cache(dataset.handle());
+    }
+
+    SECTION("contiguous dataset has no chunk shape")
+    {
+        auto dataset = file.dataset<int, 2>("data");
+        dataset.write(data.data(), {1000, 100});
+        CHECK(dataset.chunk_shape() == h5::shape<2>{0, 0});
+    }
+}
+
+TEST_CASE("dataset::write - chooses chunk shape for access pattern")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    h5::shape<2> const shape = {100000, 100};
+    std::vector<float> data(shape.size());
+
+    h5::dataset_options options;
+    options.compression = 1;
+
+    SECTION("row scan")
+    {
+        options.access = h5::access_pattern::row_scan;
+        auto dataset = file.dataset<float, 2>("data");
+        dataset.write(data.data(), shape, options);
+
+        // Chunks span whole rows.
+        CHECK(dataset.chunk_shape().dims[1] == 100);
+    }
+
+    SECTION("column scan")
+    {
+        options.access = h5::access_pattern::column_scan;
+        auto dataset = file.dataset<float, 2>("data");
+        dataset.write(data.data(), shape, options);
+
+        // Chunks are narrow and long.
+        auto const chunk = dataset.chunk_shape();
+        CHECK(chunk.dims[1] == 1);
+        CHECK(chunk.dims[0] > 1000);
+    }
+
+    SECTION("random tile")
+    {
+        options.access = h5::access_pattern::random_tile;
+        auto dataset = file.dataset<float, 2>("data");
+        dataset.write(data.data(), shape, options);
+
+        auto const chunk = dataset.chunk_shape();
+        CHECK(chunk.dims[0] <= 2 * chunk.dims[1]);
+        CHECK(chunk.dims[1] <= 2 * chunk.dims[0]);
+    }
+
+    SECTION("explicit chunk")
+    {
+        options.chunk = std::vector<std::size_t>{1000, 1000};
+        auto dataset = file.dataset<float, 2>("data");
+        dataset.write(data.data(), shape, options);
+
+        // Clipped to the dataset shape.
+        CHECK(dataset.chunk_shape() == h5::shape<2>{1000, 100});
+    }
+
+    SECTION("explicit chunk without compression")
+    {
+        h5::dataset_options chunk_options;
+        chunk_options.chunk = std::vector<std::size_t>{10, 10};
+        auto dataset = file.dataset<float, 2>("data");
+        dataset.write(data.data(), shape, chunk_options);
+
+        CHECK(dataset.chunk_shape() == h5::shape<2>{10, 10});
+    }
+
+    SECTION("invalid explicit chunk")
+    {
+        options.chunk = std::vector<std::size_t>{10};
+        auto dataset = file.dataset<float, 2>("data");
+        CHECK_THROWS_AS(dataset.write(data.data(), shape, options), h5::exception);
+    }
+
+    SECTION("column scan stream")
+    {
+        options.access = h5::access_pattern::column_scan;
+        auto dataset = file.dataset<float, 2>("data");
+        auto stream = dataset.stream_writer({10000}, options);
+
+        // A chunk holds many records.
+        CHECK(dataset.chunk_shape().dims[0] >= 64);
+    }
+
+    SECTION("explicit chunk stream")
+    {
+        options.chunk = std::vector<std::size_t>{16, 50};
+        auto dataset = file.dataset<float, 2>("data");
+        auto stream = dataset.stream_writer({100}, options);
+
+        CHECK(dataset.chunk_shape() == h5::shape<2>{16, 50});
+    }
+}
+
+TEST_CASE("dataset::tune - chooses storage options by trial")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    // Smooth, compressible data.
+    h5::shape<2> const shape = {1000, 300};
+    std::vector<int> data(shape.size());
+    for (std::size_t i = 0; i < shape.dims[0]; i++) {
+        for (std::size_t j = 0; j < shape.dims[1]; j++) {
+            data[i * shape.dims[1] + j] = int(i / 10 + j % 7);
+        }
+    }
+
+    auto dataset = file.dataset<int, 2>("data");
+
+    SECTION("size goal")
+    {
+        auto const result = dataset.tune(data.data(), shape, h5::tune_goal::size);
+
+        // Nothing written.
+        CHECK_FALSE(dataset);
+
+        CHECK(result.trials > 1);
+        CHECK(result.sample_bytes > 0);
+        CHECK(result.options.chunk);
+        CHECK(result.options.compression);
+        CHECK(result.compression_ratio > 1);
+        CHECK_FALSE(result.options.tune);
+
+        dataset.write(data.data(), shape, result.options);
+
+        std::vector<int> actual(shape.size());
+        dataset.read(actual.data(), shape);
+        CHECK(actual == data);
+    }
+
+    SECTION("explicit chunk is kept")
+    {
+        h5::dataset_options base;
+        base.chunk = std::vector<std::size_t>{10, 300};
+
+        auto const result = dataset.tune(data.data(), shape, h5::tune_goal::read_speed, base);
+        CHECK(*result.options.chunk == *base.chunk);
+    }
+
+    SECTION("tune option")
+    {
+        h5::dataset_options options;
+        options.tune = h5::tune_goal::balanced;
+        dataset.write(data.data(), shape, options);
+
+        CHECK(dataset.chunk_shape().size() > 0);
+
+        std::vector<int> actual(shape.size());
+        dataset.read(actual.data(), shape);
+        CHECK(actual == data);
+    }
+}
+
+TEST_CASE("dataset::map - maps contiguous dataset")
+{
+    temporary tmp;
+
+    h5::shape<2> const shape = {100, 30};
+    std::vector<double> data(shape.size());
+    for (std::size_t i = 0; i < data.size(); i++) {
+        data[i] = double(i) / 7;
+    }
+
+    auto const open_datasets = H5Fget_obj_count(H5F_OBJ_ALL, H5F_OBJ_DATASET);
+
+    h5::mapped_array<double const, 2> view;
+    {
+        h5::file file(tmp.filename, "w");
+
+        auto dataset = file.dataset<h5::f64, 2>("data");
+        dataset.write(data.data(), shape);
+
+        view = dataset.map();
+        CHECK(view.shape() == shape);
+        CHECK(std::vector<double>(view.begin(), view.end()) == data);
+
+        SECTION("type mismatch")
+        {
+            CHECK_THROWS_AS(dataset.map<float>(), h5::exception);
+        }
+
+        SECTION("compressed dataset")
+        {
+            h5::dataset_options options;
+            options.compression = 1;
+            auto compressed = file.dataset<h5::f64, 2>("compressed");
+            compressed.write(data.data(), shape, options);
+            CHECK_THROWS_AS(compressed.map(), h5::exception);
+        }
+    }
+
+    // The view keeps the dataset open after the file is closed.
+    CHECK(view[31] == data[31]);
+    CHECK(H5Fget_obj_count(H5F_OBJ_ALL, H5F_OBJ_DATASET) == open_datasets + 1);
+
+    view = {};
+    CHECK(H5Fget_obj_count(H5F_OBJ_ALL, H5F_OBJ_DATASET) == open_datasets);
+}
+
+TEST_CASE("dataset::map_writable - fills allocated dataset in place")
+{
+    temporary tmp;
+
+    h5::shape<2> const shape = {200, 50};
+    {
+        h5::file file(tmp.filename, "w");
+
+        auto dataset = file.dataset<h5::i32, 2>("data");
+        dataset.allocate(shape);
+        CHECK(dataset.shape() == shape);
+
+        auto view = dataset.map_writable();
+        REQUIRE(view.size() == shape.size());
+        for (std::size_t i = 0; i < view.size(); i++) {
+            view[i] = int(i);
+        }
+    }
+
+    h5::file file(tmp.filename, "r");
+    auto dataset = file.dataset<h5::i32, 2>("data");
+
+    std::vector<int> expect(shape.size());
+    for (std::size_t i = 0; i < expect.size(); i++) {
+        expect[i] = int(i);
+    }
+
+    std::vector<int> actual(shape.size());
+    dataset.read(actual.data(), shape);
+    CHECK(actual == expect);
+
+    CHECK_THROWS_AS(dataset.map_writable(), h5::exception);
+}
+
+TEST_CASE("dataset::map_writable - later reads see values written to view")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    // Datasets smaller and larger than the sieve buffer. Small reads before
+    // mapping load the raw data cache of HDF5.
+    for (std::size_t const rows : {4u, 1000u}) {
+        h5::shape<2> const shape = {rows, 25};
+
+        auto dataset = file.dataset<h5::i32, 2>("data" + std::to_string(rows));
+        std::vector<int> data(shape.size(), -1);
+        dataset.write(data.data(), shape);
+
+        int value;
+        dataset.read_slice(&value, {rows / 2, 0}, {1, 1});
+        dataset.read_slice(&value, {0, 0}, {1, 1});
+        CHECK(value == -1);
+
+        {
+            auto view = dataset.map_writable();
+            for (std::size_t i = 0; i < view.size(); i++) {
+                view[i] = int(i);
+            }
+        }
+
+        dataset.read_slice(&value, {0, 3}, {1, 1});
+        CHECK(value == 3);
+        dataset.read_slice(&value, {rows / 2, 1}, {1, 1});
+        CHECK(value == int(rows / 2 * 25 + 1));
+
+        for (std::size_t i = 0; i < data.size(); i++) {
+            data[i] = int(i);
+        }
+        std::vector<int> actual(shape.size());
+        dataset.read(actual.data(), shape);
+        CHECK(actual == data);
+    }
+}
+
+TEST_CASE("dataset::allocate - replaces unallocated dataset of same shape")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    // A contiguous dataset created without data has no storage.
+    {
+        hsize_t const dims[] = {100};
+        h5::unique_hid<H5Sclose> dataspace = H5Screate_simple(1, dims, nullptr);
+        h5::unique_hid<H5Dclose> dataset = H5Dcreate2(
+            file.handle(), "data", H5T_STD_I32LE, dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT
+        );
+        REQUIRE(dataset >= 0);
+    }
+
+    auto dataset = file.dataset<h5::i32, 1>("data");
+    dataset.allocate({100});
+
+    auto view = dataset.map_writable();
+    CHECK(view.size() == 100);
+}
+
 TEST_CASE("dataset - can read and write numeric and string scalar")
 {
     SECTION("i32")
@@ -337,6 +896,22 @@ TEST_CASE("dataset - can read and write numeric and string scalar")
     }
 }
 
+TEST_CASE("dataset::write - overwrites scalar of same type in place")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    auto dataset = file.dataset<int>("scalar");
+    dataset.write(1);
+
+    auto observer = file.dataset<int>("scalar");
+    dataset.write(2);
+
+    int value;
+    observer.read(value);
+    CHECK(value == 2);
+}
+
 TEST_CASE("dataset - can read and write numeric and string array")
 {
     SECTION("i32")
@@ -425,3 +1000,191 @@ TEST_CASE("dataset - D parameter")
     file.dataset<h5::u64>("u64").write(0);
     file.dataset<h5::str>("str").write(std::string(""));
 }
+
+TEST_CASE("dataset::read_slice - reads a region of dataset")
+{
+    temporary tmp;
+    copy("data/sample.h5", tmp.filename);
+
+    h5::file file(tmp.filename, "r");
+
+    // simple/int_2 is a 10x5 matrix with element (i, j) = i - j.
+    h5::dataset<int, 2> dataset = file.dataset<int, 2>("simple/int_2");
+    REQUIRE(dataset);
+
+    SECTION("contiguous region")
+    {
+        std::vector<int> const expect = {
+            1, 0, -1,
+            2, 1, 0
+        };
+        std::vector<int> actual(6);
+        dataset.read_slice(actual.data(), {2, 1}, {2, 3});
+        CHECK(actual == expect);
+    }
+
+    SECTION("strided region")
+    {
+        std::vector<int> const expect = {
+            1, -1,
+            4, 2,
+            7, 5
+        };
+        std::vector<int> actual(6);
+        dataset.read_slice(actual.data(), {1, 0}, {3, 2}, {3, 2});
+        CHECK(actual == expect);
+    }
+
+    SECTION("buffer")
+    {
+        std::vector<int> const expect = {5, 6, 7, 8, 9};
+        std::vector<int> actual(5);
+        file.dataset<int, 1>("simple/int_1").read_slice(actual, {5});
+        CHECK(actual == expect);
+    }
+
+    SECTION("out of bounds")
+    {
+        std::vector<int> actual(6);
+        CHECK_THROWS_AS(
+            dataset.read_slice(actual.data(), {9, 0}, {2, 3}), h5::exception
+        );
+        CHECK_THROWS_AS(
+            dataset.read_slice(actual.data(), {0, 0}, {3, 2}, {5, 1}), h5::exception
+        );
+    }
+}
+
+TEST_CASE("dataset::write_slice - overwrites a region in place")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    SECTION("numeric")
+    {
+        auto dataset = file.dataset<int, 2>("data");
+
+        std::vector<int> const data(4 * 5, 0);
+        dataset.write(data.data(), {4, 5});
+        auto const handle = dataset.handle();
+
+        std::vector<int> const region = {1, 2, 3, 4};
+        dataset.write_slice(region.data(), {1, 1}, {2, 2}, {2, 3});
+
+        // The dataset is not recreated.
+        CHECK(dataset.handle() == handle);
+
+        std::vector<int> const expect = {
+            0, 0, 0, 0, 0,
+            0, 1, 0, 0, 2,
+            0, 0, 0, 0, 0,
+            0, 3, 0, 0, 4
+        };
+        std::vector<int> actual(expect.size());
+        dataset.read(actual.data(), {4, 5});
+        CHECK(actual == expect);
+    }
+
+    SECTION("string")
+    {
+        auto dataset = file.dataset<h5::str, 1>("data");
+
+        std::vector<std::string> const data = {"a", "b", "c", "d"};
+        dataset.write(data);
+
+        std::vector<std::string> const region = {"x", "y"};
+        dataset.write_slice(region, {1});
+
+        std::vector<std::string> actual(2);
+        dataset.read_slice(actual, {0}, {2});
+
+        std::vector<std::string> const expect = {"a", "y"};
+        CHECK(actual == expect);
+    }
+
+    SECTION("requires existing dataset")
+    {
+        auto dataset = file.dataset<int, 1>("data");
+        std::vector<int> const region = {1, 2};
+        CHECK_THROWS_AS(dataset.write_slice(region, {0}), h5::exception);
+    }
+}
+
+TEST_CASE("dataset::read_rows - gathers rows in requested order")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    // 1000x3 matrix with element (i, j) = 10 * i + j.
+    std::vector<long> data(1000 * 3);
+    for (std::size_t i = 0; i < data.size(); i++) {
+        data[i] = long(10 * (i / 3) + i % 3);
+    }
+
+    h5::dataset_options options;
+    options.compression = 1;
+
+    auto dataset = file.dataset<h5::i64, 2>("data");
+    dataset.write(data.data(), {1000, 3}, options);
+
+    SECTION("unordered with duplicates")
+    {
+        std::vector<std::size_t> const indices = {999, 3, 4, 5, 3, 0};
+        std::vector<long> const expect = {
+            9990, 9991, 9992,
+            30, 31, 32,
+            40, 41, 42,
+            50, 51, 52,
+            30, 31, 32,
+            0, 1, 2
+        };
+        std::vector<long> actual(indices.size() * 3);
+        dataset.read_rows(actual.data(), indices);
+        CHECK(actual == expect);
+    }
+
+    SECTION("sorted")
+    {
+        std::vector<std::size_t> const indices = {1, 2, 500};
+        std::vector<long> const expect = {
+            10, 11, 12,
+            20, 21, 22,
+            5000, 5001, 5002
+        };
+        std::vector<long> actual(indices.size() * 3);
+        dataset.read_rows(actual.data(), indices);
+        CHECK(actual == expect);
+    }
+
+    SECTION("empty")
+    {
+        std::vector<long> actual;
+        dataset.read_rows(actual.data(), {});
+    }
+
+    SECTION("out of bounds")
+    {
+        std::vector<long> actual(3);
+        CHECK_THROWS_AS(dataset.read_rows(actual.data(), {1000}), h5::exception);
+    }
+}
+
+TEST_CASE("dataset::read_points - gathers elements in requested order")
+{
+    temporary tmp;
+    copy("data/sample.h5", tmp.filename);
+
+    h5::file file(tmp.filename, "r");
+
+    // simple/int_2 is a 10x5 matrix with element (i, j) = i - j.
+    h5::dataset<int, 2> dataset = file.dataset<int, 2>("simple/int_2");
+
+    std::vector<h5::shape<2>> const coords = {{9, 0}, {0, 4}, {5, 2}, {9, 0}};
+    std::vector<int> const expect = {9, -4, 3, 9};
+
+    std::vector<int> actual(coords.size());
+    dataset.read_points(actual.data(), coords);
+    CHECK(actual == expect);
+
+    CHECK_THROWS_AS(dataset.read_points(actual.data(), {{10, 0}}), h5::exception);
+}
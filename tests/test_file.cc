@@ -1,3 +1,10 @@
+#include <cstdio>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <h5.hpp>
 
 #include <catch.hpp>
@@ -38,3 +45,841 @@ TEST_CASE("file - accepts mode string")
         h5::file(tmp.filename, "w-");
     }
 }
+
+TEST_CASE("file - applies file creation options")
+{
+    temporary tmp;
+
+    h5::file_options options;
+    options.space_strategy = h5::file_space_strategy::page;
+    options.persist_free_space = true;
+    options.free_space_threshold = 1;
+    options.page_size = 8192;
+
+    h5::file file(tmp.filename, "w", options);
+
+    h5::unique_hid<H5Pclose> file_props = H5Fget_create_plist(file.handle());
+    REQUIRE(file_props >= 0);
+
+    H5F_fspace_strategy_t strategy;
+    hbool_t persist;
+    hsize_t threshold;
+    hsize_t page_size;
+    REQUIRE(H5Pget_file_space_strategy(file_props, &strategy, &persist, &threshold) >= 0);
+    REQUIRE(H5Pget_file_space_page_size(file_props, &page_size) >= 0);
+
+    CHECK(strategy == H5F_FSPACE_STRATEGY_PAGE);
+    CHECK(persist);
+    CHECK(threshold == 1);
+    CHECK(page_size == 8192);
+}
+
+TEST_CASE("file - keeps file in memory and exchanges file image")
+{
+    temporary tmp;
+
+    h5::shape<1> const shape = {5};
+    std::vector<int> const data = {1, 2, 3, 4, 5};
+
+    h5::file_options options;
+    options.driver = h5::file_driver::core;
+
+    std::vector<unsigned char> image;
+    {
+        h5::file file(tmp.filename, "w", options);
+        file.dataset<h5::i32, 1>("data").write(data.data(), shape);
+        image = file.image();
+    }
+
+    // Nothing is written to disk without backing store.
+    CHECK_THROWS_AS(h5::file(tmp.filename, "r"), h5::exception);
+
+    SECTION("open image")
+    {
+        h5::file_options image_options;
+        image_options.image = image;
+
+        h5::file file("image", "r", image_options);
+
+        std::vector<int> actual(shape.size());
+        file.dataset<h5::i32, 1>("data").read(actual.data(), shape);
+        CHECK(actual == data);
+    }
+
+    SECTION("modify image")
+    {
+        h5::file_options image_options;
+        image_options.image = image;
+
+        h5::file file("image", "r+", image_options);
+        file.dataset<h5::i32>("scalar").write(42);
+        auto const modified_image = file.image();
+
+        image_options.image = modified_image;
+        h5::file modified("modified", "r", image_options);
+
+        int value = 0;
+        modified.dataset<h5::i32>("scalar").read(value);
+        CHECK(value == 42);
+    }
+
+    SECTION("image with creation mode")
+    {
+        h5::file_options image_options;
+        image_options.image = image;
+        CHECK_THROWS_AS(h5::file("image", "w", image_options), h5::exception);
+    }
+
+    SECTION("backing store")
+    {
+        options.backing_store = true;
+        {
+            h5::file file(tmp.filename, "w", options);
+            file.dataset<h5::i32, 1>("data").write(data.data(), shape);
+        }
+
+        std::vector<int> actual(shape.size());
+        h5::file(tmp.filename, "r").dataset<h5::i32, 1>("data").read(actual.data(), shape);
+        CHECK(actual == data);
+    }
+}
+
+TEST_CASE("file - applies file access options")
+{
+    temporary tmp;
+
+    h5::shape<1> const shape = {10000};
+    std::vector<double> const data(shape.size(), 1.5);
+
+    SECTION("format and layout")
+    {
+        h5::file_options options;
+        options.driver = h5::file_driver::stdio;
+        options.libver_latest = true;
+        options.alignment = 4096;
+        options.alignment_threshold = 1024;
+        options.sieve_buffer_size = 1024 * 1024;
+
+        h5::file file(tmp.filename, "w", options);
+
+        h5::unique_hid<H5Pclose> access_props = H5Fget_access_plist(file.handle());
+        REQUIRE(access_props >= 0);
+
+        H5F_libver_t low;
+        H5F_libver_t high;
+        hsize_t threshold;
+        hsize_t alignment;
+        std::size_t sieve_size;
+        REQUIRE(H5Pget_libver_bounds(access_props, &low, &high) >= 0);
+        REQUIRE(H5Pget_alignment(access_props, &threshold, &alignment) >= 0);
+        REQUIRE(H5Pget_sieve_buf_size(access_props, &sieve_size) >= 0);
+
+        CHECK(H5Pget_driver(access_props) == H5FD_STDIO);
+        CHECK(low == H5F_LIBVER_LATEST);
+        CHECK(high == H5F_LIBVER_LATEST);
+        CHECK(threshold == 1024);
+        CHECK(alignment == 4096);
+        CHECK(sieve_size == 1024 * 1024);
+
+        auto dataset = file.dataset<h5::f64, 1>("data");
+        dataset.write(data.data(), shape);
+        CHECK(H5Dget_offset(dataset.handle()) % 4096 == 0);
+    }
+
+    SECTION("family driver")
+    {
+        auto const pattern = tmp.filename + "%d";
+
+        h5::file_options options;
+        options.driver = h5::file_driver::family;
+        options.family_size = 16384;
+        {
+            h5::file file(pattern, "w", options);
+            file.dataset<h5::f64, 1>("data").write(data.data(), shape);
+        }
+
+        std::vector<double> actual(shape.size());
+        h5::file(pattern, "r", options).dataset<h5::f64, 1>("data").read(actual.data(), shape);
+        CHECK(actual == data);
+
+        for (int i = 0; ; i++) {
+            if (std::remove((tmp.filename + std::to_string(i)).c_str()) != 0) {
+                CHECK(i > 1);
+                break;
+            }
+        }
+    }
+}
+
+TEST_CASE("file - applies page buffer options")
+{
+    temporary tmp;
+
+    h5::shape<1> const shape = {16};
+    std::vector<int> const data(shape.size(), 7);
+
+    h5::file_options create_options;
+    create_options.space_strategy = h5::file_space_strategy::page;
+    create_options.page_size = 65536;
+    create_options.metadata_block_size = 65536;
+    {
+        h5::file file(tmp.filename, "w", create_options);
+        for (int i = 0; i < 100; i++) {
+            file.dataset<h5::i32, 1>("data/" + std::to_string(i)).write(data.data(), shape);
+        }
+    }
+
+    h5::file_options options;
+    options.page_buffer_size = 16 * 65536;
+    options.page_buffer_min_meta = 50;
+
+#if H5_VERSION_GE(1, 12, 0)
+    h5::file file(tmp.filename, "r", options);
+
+    h5::unique_hid<H5Pclose> access_props = H5Fget_access_plist(file.handle());
+    REQUIRE(access_props >= 0);
+
+    std::size_t buffer_size;
+    unsigned min_meta;
+    unsigned min_raw;
+    REQUIRE(H5Pget_page_buffer_size(access_props, &buffer_size, &min_meta, &min_raw) >= 0);
+    CHECK(buffer_size == 16 * 65536);
+    CHECK(min_meta == 50);
+
+    for (int i = 0; i < 100; i++) {
+        std::vector<int> actual(shape.size());
+        file.dataset<h5::i32, 1>("data/" + std::to_string(i)).read(actual.data(), shape);
+        CHECK(actual == data);
+    }
+
+    SECTION("non-paged file")
+    {
+        temporary plain;
+        h5::file(plain.filename, "w");
+        CHECK_THROWS_AS(h5::file(plain.filename, "r", options), h5::exception);
+    }
+#else
+    // The page buffer of HDF5 1.10 is unsafe.
+    CHECK_THROWS_AS(h5::file(tmp.filename, "r", options), h5::exception);
+#endif
+}
+
+TEST_CASE("file - applies metadata cache options")
+{
+    temporary tmp;
+
+    h5::shape<1> const shape = {4};
+    std::vector<int> const data = {1, 2, 3, 4};
+
+    h5::file_options options;
+    options.cache_image = true;
+    options.metadata_cache_size = 8 * 1024 * 1024;
+    options.metadata_cache_max_size = 16 * 1024 * 1024;
+    {
+        h5::file file(tmp.filename, "w", options);
+
+        H5AC_cache_config_t config;
+        config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+        REQUIRE(H5Fget_mdc_config(file.handle(), &config) >= 0);
+        CHECK(config.initial_size == 8 * 1024 * 1024);
+        CHECK(config.max_size == 16 * 1024 * 1024);
+
+        h5::unique_hid<H5Pclose> access_props = H5Fget_access_plist(file.handle());
+        REQUIRE(access_props >= 0);
+
+        H5AC_cache_image_config_t image_config;
+        image_config.version = H5AC__CURR_CACHE_IMAGE_CONFIG_VERSION;
+        REQUIRE(H5Pget_mdc_image_config(access_props, &image_config) >= 0);
+        CHECK(image_config.generate_image);
+
+        for (int i = 0; i < 10; i++) {
+            file.dataset<h5::i32, 1>("data/" + std::to_string(i)).write(data.data(), shape);
+        }
+    }
+
+    // The saved cache image is loaded on open.
+    h5::file file(tmp.filename, "r");
+
+    haddr_t image_addr;
+    hsize_t image_size;
+    REQUIRE(H5Fget_mdc_image_info(file.handle(), &image_addr, &image_size) >= 0);
+    CHECK(image_addr != HADDR_UNDEF);
+    CHECK(image_size > 0);
+
+    std::vector<int> actual(shape.size());
+    file.dataset<h5::i32, 1>("data/9").read(actual.data(), shape);
+    CHECK(actual == data);
+}
+
+TEST_CASE("file - caches dataset handles by path")
+{
+    temporary tmp;
+    copy("data/sample.h5", tmp.filename);
+
+    h5::file_options options;
+    options.dataset_cache_size = 16;
+
+    h5::file file(tmp.filename, "r+", options);
+
+    // simple/int_2 is a 10x5 matrix.
+    auto first = file.dataset<int, 2>("simple/int_2");
+    auto second = file.dataset<int, 2>("/simple/int_2");
+    CHECK(first.handle() == second.handle());
+    CHECK(second.shape() == h5::shape<2>{10, 5});
+
+    // Checks are done on cache hits as well.
+    CHECK_THROWS_AS((file.dataset<int, 1>("simple/int_2")), h5::exception);
+    CHECK_THROWS_AS((file.dataset<h5::str, 2>("simple/int_2")), h5::exception);
+
+    // Closing one object keeps the shared handle valid.
+    {
+        auto third = file.dataset<int, 2>("simple/int_2");
+    }
+    std::vector<int> values(50);
+    first.read(values.data(), {10, 5});
+    CHECK(values[5] == 1);
+
+    SECTION("replaced dataset")
+    {
+        std::vector<int> const data(6, 1);
+        first.write(data.data(), {2, 3});
+        CHECK(first.shape() == h5::shape<2>{2, 3});
+
+        auto reopened = file.dataset<int, 2>("simple/int_2");
+        CHECK(reopened.shape() == h5::shape<2>{2, 3});
+    }
+
+    SECTION("stream")
+    {
+        auto dataset = file.dataset<int, 2>("simple/int_2");
+        {
+            auto stream = dataset.stream_writer({5});
+            std::vector<int> const record(5, 0);
+            stream.write(record.data());
+        }
+        CHECK(file.dataset<int, 2>("simple/int_2").shape() == h5::shape<2>{1, 5});
+    }
+
+    SECTION("dataset replaced without the file")
+    {
+        std::vector<int> const data(6, 2);
+        h5::dataset<int, 2>(file.handle(), "simple/int_2").write(data.data(), {3, 2});
+
+        auto reopened = file.dataset<int, 2>("simple/int_2");
+        CHECK(reopened.shape() == h5::shape<2>{3, 2});
+
+        std::vector<int> actual(6);
+        reopened.read(actual.data(), {3, 2});
+        CHECK(actual == data);
+    }
+
+    SECTION("dataset unlinked")
+    {
+        REQUIRE(H5Ldelete(file.handle(), "simple/int_2", H5P_DEFAULT) >= 0);
+
+        auto reopened = file.dataset<int, 2>("simple/int_2");
+        CHECK_FALSE(reopened);
+    }
+
+    SECTION("dataset unlinked and recreated")
+    {
+        REQUIRE(H5Ldelete(file.handle(), "simple/int_2", H5P_DEFAULT) >= 0);
+
+        std::vector<int> const data(50, 4);
+        h5::dataset<int, 2>(file.handle(), "simple/int_2").write(data.data(), {10, 5});
+
+        auto reopened = file.dataset<int, 2>("simple/int_2");
+        CHECK(reopened.handle() != first.handle());
+
+        std::vector<int> actual(50);
+        reopened.read(actual.data(), {10, 5});
+        CHECK(actual == data);
+    }
+
+    SECTION("parent group replaced")
+    {
+        REQUIRE(H5Ldelete(file.handle(), "simple", H5P_DEFAULT) >= 0);
+
+        std::vector<int> const data(4, 3);
+        h5::dataset<int, 2>(file.handle(), "simple/int_2").write(data.data(), {2, 2});
+
+        auto reopened = file.dataset<int, 2>("simple/int_2");
+        CHECK(reopened.shape() == h5::shape<2>{2, 2});
+    }
+}
+
+TEST_CASE("file - bounds dataset handle cache")
+{
+    temporary tmp;
+
+    h5::file_options options;
+    options.dataset_cache_size = 2;
+
+    h5::file file(tmp.filename, "w", options);
+
+    std::vector<int> const data = {1, 2};
+    for (int i = 0; i < 3; i++) {
+        file.dataset<int, 1>(std::to_string(i)).write(data.data(), {2});
+    }
+
+    auto const count_open_datasets = [&] {
+        return H5Fget_obj_count(file.handle(), H5F_OBJ_DATASET | H5F_OBJ_LOCAL);
+    };
+
+    file.dataset<int, 1>("0");
+    file.dataset<int, 1>("1");
+    CHECK(count_open_datasets() == 2);
+
+    // The least recently used handle is closed.
+    file.dataset<int, 1>("2");
+    CHECK(count_open_datasets() == 2);
+
+    SECTION("disabled by default")
+    {
+        h5::file uncached(tmp.filename, "r");
+        auto first = uncached.dataset<int, 1>("0");
+        auto second = uncached.dataset<int, 1>("0");
+        CHECK(first.handle() != second.handle());
+    }
+}
+
+TEST_CASE("file - lists objects in group")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    std::vector<int> const ints(6);
+    std::vector<double> const reals(4);
+    file.dataset<int, 2>("b").write(ints.data(), {2, 3});
+    file.dataset<double, 1>("a/x").write(reals.data(), {4});
+
+    SECTION("direct children")
+    {
+        auto const objects = file.list();
+        REQUIRE(objects.size() == 2);
+        CHECK(objects[0].path == "a");
+        CHECK(objects[0].type == h5::object_type::group);
+        CHECK(objects[1].path == "b");
+        CHECK(objects[1].type == h5::object_type::dataset);
+        CHECK(objects[1].rank == 2);
+        CHECK(objects[1].shape == std::vector<std::size_t>{2, 3});
+        CHECK(objects[1].value_class == h5::type_class::integer);
+        CHECK(objects[1].value_size == sizeof(int));
+    }
+
+    SECTION("recursive")
+    {
+        h5::list_options options;
+        options.recursive = true;
+        options.dataset_info = false;
+
+        auto const objects = file.list("/", options);
+        REQUIRE(objects.size() == 3);
+        CHECK(objects[1].path == "a/x");
+        CHECK(objects[1].type == h5::object_type::dataset);
+        CHECK(objects[1].rank == 0);
+    }
+
+    SECTION("creation order")
+    {
+        h5::unique_hid<H5Pclose> props = H5Pcreate(H5P_GROUP_CREATE);
+        H5Pset_link_creation_order(props, H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED);
+        h5::unique_hid<H5Gclose> group = H5Gcreate2(
+            file.handle(), "ordered", H5P_DEFAULT, props, H5P_DEFAULT
+        );
+        file.dataset<int, 1>("ordered/z").write(ints.data(), {6});
+        file.dataset<int, 1>("ordered/y").write(ints.data(), {6});
+
+        auto const objects = file.list("ordered");
+        REQUIRE(objects.size() == 2);
+        CHECK(objects[0].path == "z");
+        CHECK(objects[1].path == "y");
+    }
+
+    SECTION("lazily")
+    {
+        h5::list_options options;
+        options.recursive = true;
+
+        // A hard link back to the parent is listed but not descended into.
+        H5Lcreate_hard(file.handle(), "a", file.handle(), "a/loop", H5P_DEFAULT, H5P_DEFAULT);
+
+        std::vector<std::string> paths;
+        file.visit("/", options, [&](h5::object_info info) {
+            paths.push_back(info.path);
+        });
+        CHECK(paths == std::vector<std::string>{"a", "a/loop", "a/x", "b"});
+
+        // Throwing from the callback stops the listing.
+        paths.clear();
+        CHECK_THROWS_AS(
+            file.visit("/", options, [&](h5::object_info info) {
+                paths.push_back(info.path);
+                throw std::runtime_error("stop");
+            }),
+            std::runtime_error
+        );
+        CHECK(paths.size() == 1);
+    }
+
+    SECTION("single object")
+    {
+        auto const info = file.info("a/x");
+        CHECK(info.type == h5::object_type::dataset);
+        CHECK(info.shape == std::vector<std::size_t>{4});
+        CHECK(info.value_class == h5::type_class::floating_point);
+        CHECK_THROWS_AS(file.info("a/nonexistent"), h5::exception);
+    }
+}
+
+TEST_CASE("file - scans files in worker processes")
+{
+    temporary tmp1;
+    temporary tmp2;
+    copy("data/sample.h5", tmp1.filename);
+    {
+        h5::file file(tmp2.filename, "w");
+        std::vector<int> const data(3);
+        file.dataset<int, 1>("only").write(data.data(), {3});
+    }
+
+    auto const caller = std::this_thread::get_id();
+    std::map<std::string, std::vector<h5::object_info>> listings;
+
+    h5::list_options options;
+    options.recursive = true;
+    h5::scan_files(
+        {tmp1.filename, tmp2.filename},
+        options,
+        [&](std::string const& filename, std::vector<h5::object_info> objects) {
+            CHECK(std::this_thread::get_id() == caller);
+            listings[filename] = std::move(objects);
+        },
+        2
+    );
+
+    REQUIRE(listings.size() == 2);
+    CHECK(listings[tmp1.filename].size() > 1);
+    REQUIRE(listings[tmp2.filename].size() == 1);
+
+    auto const& info = listings[tmp2.filename][0];
+    CHECK(info.path == "only");
+    CHECK(info.type == h5::object_type::dataset);
+    CHECK(info.rank == 1);
+    CHECK(info.shape == std::vector<std::size_t>{3});
+    CHECK(info.value_class == h5::type_class::integer);
+    CHECK(info.value_size == sizeof(int));
+
+    CHECK_THROWS_AS(
+        h5::scan_files({"nonexistent.h5"}, options, [](std::string const&, std::vector<h5::object_info>) {}),
+        h5::exception
+    );
+
+    // An exception thrown by the callback stops the scan.
+    std::size_t calls = 0;
+    CHECK_THROWS_AS(
+        h5::scan_files(
+            {tmp1.filename, tmp2.filename, tmp1.filename},
+            options,
+            [&](std::string const&, std::vector<h5::object_info>) {
+                calls++;
+                throw std::runtime_error("stop");
+            },
+            1
+        ),
+        std::runtime_error
+    );
+    CHECK(calls == 1);
+}
+
+TEST_CASE("file - maintains dataset catalog")
+{
+    temporary tmp;
+
+    h5::file_options options;
+    options.catalog = true;
+
+    auto const catalog_valid = [](hid_t file) {
+        h5::unique_hid<H5Aclose> valid = H5Aopen_by_name(
+            file, "/.catalog", "valid", H5P_DEFAULT, H5P_DEFAULT
+        );
+        std::uint8_t value = 0;
+        H5Aread(valid, H5T_NATIVE_UINT8, &value);
+        return value != 0;
+    };
+
+    std::vector<int> const ints(6);
+    std::vector<double> const reals(4);
+    {
+        h5::file file(tmp.filename, "w", options);
+        file.dataset<int, 2>("a").write(ints.data(), {2, 3});
+        file.dataset<double, 1>("g/b").write(reals.data(), {4});
+
+        auto dataset = file.dataset<int, 2>("s");
+        auto stream = dataset.stream_writer({3});
+        stream.write(ints.data());
+        stream.write(ints.data());
+        stream.flush();
+
+        // Entries are up to date before the catalog is stored.
+        CHECK(file.info("s").shape == std::vector<std::size_t>{2, 3});
+        CHECK(file.catalog().size() == 3);
+    }
+
+    SECTION("loaded on open")
+    {
+        h5::file file(tmp.filename, "r", options);
+        CHECK(H5Lexists(file.handle(), ".catalog", H5P_DEFAULT) > 0);
+
+        auto const entries = file.catalog();
+        REQUIRE(entries.size() == 3);
+        CHECK(entries[0].path == "a");
+        CHECK(entries[0].shape == std::vector<std::size_t>{2, 3});
+        CHECK(entries[0].value_class == h5::type_class::integer);
+        CHECK(entries[1].path == "g/b");
+        CHECK(entries[1].value_class == h5::type_class::floating_point);
+        CHECK(entries[1].value_size == sizeof(double));
+        CHECK(entries[1].storage_size == sizeof(double) * 4);
+        CHECK(entries[2].path == "s");
+        CHECK(entries[2].shape == std::vector<std::size_t>{2, 3});
+
+        CHECK(file.info("/g/b").shape == std::vector<std::size_t>{4});
+        CHECK(file.info("g").type == h5::object_type::group);
+
+        // The catalog itself is hidden.
+        auto const objects = file.list();
+        REQUIRE(objects.size() == 3);
+        for (auto const& object : objects) {
+            CHECK(object.path != ".catalog");
+        }
+        CHECK_THROWS_AS(file.info("/.catalog"), h5::exception);
+
+        // Integers are stored in little-endian.
+        h5::unique_hid<H5Dclose> catalog = H5Dopen2(file.handle(), ".catalog", H5P_DEFAULT);
+        h5::unique_hid<H5Tclose> catalog_type = H5Dget_type(catalog);
+        h5::unique_hid<H5Tclose> size_type = H5Tget_member_type(catalog_type, 0);
+        CHECK(H5Tequal(size_type, H5T_STD_U64LE) > 0);
+    }
+
+    SECTION("updated on write")
+    {
+        h5::file file(tmp.filename, "r+", options);
+        file.dataset<int, 2>("a").write(ints.data(), {3, 2});
+        CHECK(file.info("a").shape == std::vector<std::size_t>{3, 2});
+
+        // The stored catalog is flagged stale until the changes are stored.
+        CHECK_FALSE(catalog_valid(file.handle()));
+        file.flush();
+        CHECK(catalog_valid(file.handle()));
+    }
+
+    SECTION("stored on close while datasets outlive the file")
+    {
+        {
+            auto dataset = [&] {
+                h5::file file(tmp.filename, "r+", options);
+                auto dataset = file.dataset<int, 2>("a");
+                dataset.write(ints.data(), {3, 2});
+                return dataset;
+            }();
+            CHECK(catalog_valid(dataset.handle()));
+
+            // Later writes are stored when the last dataset is closed.
+            dataset.write(ints.data(), {1, 6});
+            CHECK_FALSE(catalog_valid(dataset.handle()));
+        }
+
+        h5::file file(tmp.filename, "r", options);
+        CHECK(catalog_valid(file.handle()));
+        CHECK(file.info("a").shape == std::vector<std::size_t>{1, 6});
+    }
+
+    SECTION("stored in place")
+    {
+        auto const session = [&] {
+            h5::file file(tmp.filename, "r+", options);
+            file.dataset<int, 2>("a").write(ints.data(), {2, 3});
+        };
+        auto const file_size = [&] {
+            h5::file file(tmp.filename, "r");
+            hsize_t size;
+            REQUIRE(H5Fget_filesize(file.handle(), &size) >= 0);
+            return size;
+        };
+
+        auto const catalog_address = [&] {
+            h5::file file(tmp.filename, "r");
+            return h5::detail::get_object_address(file.handle(), ".catalog");
+        };
+
+        session();
+        auto const size = file_size();
+        auto const address = catalog_address();
+        for (int i = 0; i < 20; i++) {
+            session();
+        }
+        CHECK(file_size() == size);
+
+        // The catalog is extendible and keeps its place in the file.
+        {
+            h5::file file(tmp.filename, "r");
+            h5::unique_hid<H5Dclose> catalog = H5Dopen2(file.handle(), ".catalog", H5P_DEFAULT);
+            h5::unique_hid<H5Sclose> space = H5Dget_space(catalog);
+            hsize_t dims[1];
+            hsize_t max_dims[1];
+            H5Sget_simple_extent_dims(space, dims, max_dims);
+            CHECK(dims[0] == 3);
+            CHECK(max_dims[0] == H5S_UNLIMITED);
+            CHECK(h5::detail::same_object_address(
+                file.handle(), h5::detail::get_object_address(file.handle(), ".catalog"), address
+            ));
+        }
+
+        // A longer path outgrowing the records recreates the catalog.
+        {
+            h5::file file(tmp.filename, "r+", options);
+            file.dataset<int, 1>(std::string(100, 'x')).write(ints.data(), {6});
+        }
+        h5::file file(tmp.filename, "r", options);
+        CHECK(file.catalog().size() == 4);
+        CHECK(file.info(std::string(100, 'x')).shape == std::vector<std::size_t>{6});
+    }
+
+    SECTION("rebuilt after modified without catalog")
+    {
+        {
+            h5::file file(tmp.filename, "r+");
+            file.dataset<int, 1>("c").write(ints.data(), {6});
+            CHECK_FALSE(catalog_valid(file.handle()));
+        }
+
+        h5::file file(tmp.filename, "r", options);
+        CHECK(file.catalog().size() == 4);
+        CHECK(file.info("c").shape == std::vector<std::size_t>{6});
+    }
+
+    SECTION("disabled")
+    {
+        h5::file file(tmp.filename, "r");
+        CHECK_THROWS_AS(file.catalog(), h5::exception);
+    }
+}
+
+TEST_CASE("file - reuses persisted free space in later sessions")
+{
+    h5::shape<1> const shape = {100000};
+    std::vector<double> data(shape.size());
+
+    auto file_size_after_reuse = [&](h5::file_options const& options) {
+        temporary tmp;
+        {
+            h5::file file(tmp.filename, "w", options);
+            file.dataset<double, 1>("old").write(data.data(), shape);
+            file.dataset<double, 1>("keep").write(data.data(), {10});
+        }
+        {
+            h5::file file(tmp.filename, "r+");
+            REQUIRE(H5Ldelete(file.handle(), "old", H5P_DEFAULT) >= 0);
+        }
+        {
+            h5::file file(tmp.filename, "r+");
+            file.dataset<double, 1>("new").write(data.data(), shape);
+
+            hsize_t size;
+            REQUIRE(H5Fget_filesize(file.handle(), &size) >= 0);
+            return size;
+        }
+    };
+
+    h5::file_options persist_options;
+    persist_options.persist_free_space = true;
+
+    auto const default_size = file_size_after_reuse(h5::file_options{});
+    auto const persist_size = file_size_after_reuse(persist_options);
+
+    CHECK(persist_size + shape.size() * sizeof(double) / 2 < default_size);
+}
+
+namespace
+{
+    // Returns true if a snapshot of the file on disk has the dataset. This
+    // reflects flushed metadata only.
+    bool flushed_has(std::string const& filename, std::string const& path)
+    {
+        temporary snapshot;
+        copy(filename, snapshot.filename);
+
+        h5::unique_hid<H5Fclose> file = H5Fopen(
+            snapshot.filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT
+        );
+        if (file < 0) {
+            return false;
+        }
+        return H5Lexists(file, path.c_str(), H5P_DEFAULT) > 0;
+    }
+}
+
+TEST_CASE("file - follows flush policy")
+{
+    temporary tmp;
+    std::vector<int> const data(100, 1);
+
+    SECTION("manual")
+    {
+        h5::file_options options;
+        options.flush = h5::flush_policy::manual();
+        h5::file file(tmp.filename, "w", options);
+
+        for (int i = 0; i < 10; i++) {
+            file.dataset<int, 1>("data" + std::to_string(i)).write(data);
+        }
+        CHECK_FALSE(flushed_has(tmp.filename, "data9"));
+
+        file.flush();
+        CHECK(flushed_has(tmp.filename, "data9"));
+    }
+
+    SECTION("every N writes")
+    {
+        h5::file_options options;
+        options.flush.writes = 3;
+        h5::file file(tmp.filename, "w", options);
+
+        file.dataset<int, 1>("a").write(data);
+        file.dataset<int, 1>("b").write(data);
+        CHECK_FALSE(flushed_has(tmp.filename, "b"));
+
+        file.dataset<int, 1>("c").write(data);
+        CHECK(flushed_has(tmp.filename, "c"));
+    }
+
+    SECTION("every N bytes")
+    {
+        h5::file_options options;
+        options.flush.writes = 0;
+        options.flush.bytes = data.size() * sizeof(int) * 2;
+        h5::file file(tmp.filename, "w", options);
+
+        file.dataset<int, 1>("a").write(data);
+        CHECK_FALSE(flushed_has(tmp.filename, "a"));
+
+        file.dataset<int, 1>("b").write(data);
+        CHECK(flushed_has(tmp.filename, "b"));
+    }
+
+    SECTION("stream writer")
+    {
+        h5::file_options options;
+        options.flush = h5::flush_policy::manual();
+        h5::file file(tmp.filename, "w", options);
+
+        auto dataset = file.dataset<int, 2>("stream");
+        auto stream = dataset.stream_writer({100});
+        stream.write(data.data());
+        stream.flush();
+        CHECK_FALSE(flushed_has(tmp.filename, "stream"));
+
+        file.flush();
+        CHECK(flushed_has(tmp.filename, "stream"));
+    }
+}
@@ -0,0 +1,104 @@
+#include <cstddef>
+#include <vector>
+
+#include <h5.hpp>
+
+#include <catch.hpp>
+
+#include "utils.hpp"
+
+
+namespace
+{
+    // Writes `count` records of shape {3} with sequential values.
+    std::vector<int> write_records(h5::dataset<int, 2>& dataset, std::size_t count)
+    {
+        h5::dataset_options options;
+        options.compression = 1;
+
+        h5::stream_options stream_options;
+        stream_options.buffered = true;
+
+        std::vector<int> data(count * 3);
+        for (std::size_t i = 0; i < data.size(); i++) {
+            data[i] = int(i);
+        }
+
+        auto stream = dataset.stream_writer({3}, options, stream_options);
+        stream.write_n(data.data(), count);
+        stream.flush();
+
+        return data;
+    }
+}
+
+
+TEST_CASE("stream_reader - reads records in order")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    auto dataset = file.dataset<int, 2>("data");
+    std::size_t const record_count = 500000;
+    auto const expected_data = write_records(dataset, record_count);
+
+    h5::stream_reader_options options;
+
+    SECTION("without prefetch")
+    {
+        options.prefetch = false;
+    }
+
+    SECTION("with prefetch")
+    {
+        options.prefetch = true;
+    }
+
+    h5::stream_reader<int, 1> stream = dataset.stream_reader(options);
+    CHECK(stream.size() == record_count);
+    CHECK(stream.record_shape() == h5::shape<1>{3});
+
+    std::vector<int> actual_data;
+    std::vector<int> record(3);
+    while (stream.read(record)) {
+        actual_data.insert(actual_data.end(), record.begin(), record.end());
+    }
+
+    CHECK(stream.position() == record_count);
+    CHECK(actual_data == expected_data);
+}
+
+TEST_CASE("stream_reader::read_n - reads blocks of records")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    auto dataset = file.dataset<int, 2>("data");
+    std::size_t const record_count = 10000;
+    auto const expected_data = write_records(dataset, record_count);
+
+    auto stream = dataset.stream_reader();
+
+    // Reads across block boundaries and converts values.
+    std::vector<double> actual_data;
+    std::vector<double> block(3 * 999);
+    for (;;) {
+        auto const count = stream.read_n(block.data(), 999);
+        if (count == 0) {
+            break;
+        }
+        actual_data.insert(actual_data.end(), block.begin(), block.begin() + long(count * 3));
+    }
+
+    REQUIRE(actual_data.size() == expected_data.size());
+    CHECK(std::equal(actual_data.begin(), actual_data.end(), expected_data.begin()));
+}
+
+TEST_CASE("dataset::stream_reader - throws if dataset does not exist")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    auto dataset = file.dataset<int, 2>("data");
+    CHECK_THROWS_AS(dataset.stream_reader(), h5::exception);
+}
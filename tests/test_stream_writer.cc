@@ -10,6 +10,22 @@
 #include "utils.hpp"
 
 
+// A value type whose memory type HDF5 cannot convert to integers.
+struct unconvertible_value
+{
+    char c;
+};
+
+namespace h5
+{
+    template<>
+    inline hid_t memory_type<unconvertible_value>()
+    {
+        return H5T_C_S1;
+    }
+}
+
+
 TEST_CASE("dataset::stream_writer - creates new dataset")
 {
     temporary tmp;
@@ -90,3 +106,494 @@ TEST_CASE("stream_writer - incrementally writes arrays to disk")
     dataset.read(actual_data.data(), expected_shape);
     CHECK(actual_data == expected_data);
 }
+
+TEST_CASE("stream_writer - buffered stream writes all records")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    h5::dataset<int, 2> dataset = file.dataset<int, 2>("data");
+
+    std::size_t const record_count = 1000;
+    h5::shape<1> const record_shape = {3};
+    std::vector<int> expected_data;
+
+    h5::stream_options stream_options;
+    stream_options.buffered = true;
+    {
+        auto stream = dataset.stream_writer(record_shape, {}, stream_options);
+
+        for (std::size_t i = 0; i < record_count; i++) {
+            std::vector<int> record = {int(i), int(i) * 2, int(i) * 3};
+            std::copy(record.begin(), record.end(), std::back_inserter(expected_data));
+
+            stream.write(record);
+
+            if (i == record_count / 2) {
+                // Flush trims the dataset to the exact number of records.
+                stream.flush();
+                CHECK(dataset.shape() == h5::shape<2>{i + 1, 3});
+            }
+        }
+
+        // Staged records may not have reached the dataset yet.
+        CHECK(dataset.shape().dims[0] <= 2 * record_count);
+    }
+
+    // Destructor writes out staged records and trims the dataset.
+    h5::shape<2> const expected_shape = {record_count, 3};
+    CHECK(dataset.shape() == expected_shape);
+
+    std::vector<int> actual_data(expected_shape.size());
+    dataset.read(actual_data.data(), expected_shape);
+    CHECK(actual_data == expected_data);
+}
+
+TEST_CASE("stream_writer - move assignment finishes replaced stream")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    h5::dataset<int, 2> first = file.dataset<int, 2>("first");
+    h5::dataset<int, 2> second = file.dataset<int, 2>("second");
+
+    h5::stream_options stream_options;
+    stream_options.buffered = true;
+    {
+        auto stream = first.stream_writer({2}, {}, stream_options);
+        std::vector<int> const record = {1, 2};
+        stream.write(record);
+        stream.write(record);
+
+        // The staged records go to the first dataset.
+        stream = second.stream_writer({2}, {}, stream_options);
+        CHECK(first.shape() == h5::shape<2>{2, 2});
+
+        stream.write(record);
+    }
+    CHECK(second.shape() == h5::shape<2>{1, 2});
+}
+
+TEST_CASE("stream_writer - buffered stream accepts mixed buffer types")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    h5::dataset<double, 2> dataset = file.dataset<double, 2>("data");
+
+    h5::stream_options stream_options;
+    stream_options.buffered = true;
+    {
+        auto stream = dataset.stream_writer({1}, {}, stream_options);
+
+        int const i = 1;
+        float const f = 2.5F;
+        double const d = 4.25;
+        stream.write(&i);
+        stream.write(&f);
+        stream.write(&d);
+        stream.write(&i);
+    }
+
+    std::vector<double> const expected_data = {1, 2.5, 4.25, 1};
+    std::vector<double> actual_data(expected_data.size());
+    dataset.read(actual_data.data(), {expected_data.size(), 1});
+    CHECK(actual_data == expected_data);
+}
+
+namespace
+{
+    // Row-major matrix with fixed number of columns.
+    struct matrix
+    {
+        std::size_t cols;
+        std::vector<int> values;
+    };
+}
+
+namespace h5
+{
+    template<>
+    struct buffer_traits<matrix>
+    {
+        using value_type = int;
+        static constexpr int rank = 2;
+
+        static h5::shape<rank> shape(matrix const& buffer)
+        {
+            return {buffer.values.size() / buffer.cols, buffer.cols};
+        }
+
+        static value_type const* data(matrix const& buffer)
+        {
+            return buffer.values.data();
+        }
+    };
+}
+
+TEST_CASE("stream_writer::write_n - appends multiple records at once")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    h5::dataset<int, 2> dataset = file.dataset<int, 2>("data");
+
+    SECTION("unbuffered")
+    {
+        auto stream = dataset.stream_writer({2});
+
+        std::vector<int> const records = {1, 2, 3, 4, 5, 6};
+        stream.write_n(records.data(), 3);
+        CHECK(dataset.shape() == h5::shape<2>{3, 2});
+
+        matrix const more = {2, {7, 8, 9, 10}};
+        stream.write_n(more);
+        CHECK(dataset.shape() == h5::shape<2>{5, 2});
+
+        std::vector<int> const expected_data = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+        std::vector<int> actual_data(expected_data.size());
+        dataset.read(actual_data.data(), {5, 2});
+        CHECK(actual_data == expected_data);
+    }
+
+    SECTION("buffered")
+    {
+        h5::stream_options stream_options;
+        stream_options.buffered = true;
+
+        std::vector<int> expected_data;
+        {
+            auto stream = dataset.stream_writer({2}, {}, stream_options);
+
+            // Small blocks are staged and large blocks are written through.
+            for (std::size_t count : {1u, 3u, 5000u, 2u, 10000u, 7u}) {
+                std::vector<int> records(count * 2);
+                for (auto& value : records) {
+                    value = int(expected_data.size());
+                    expected_data.push_back(value);
+                }
+                stream.write_n(records.data(), count);
+            }
+        }
+
+        h5::shape<2> const expected_shape = {expected_data.size() / 2, 2};
+        CHECK(dataset.shape() == expected_shape);
+
+        std::vector<int> actual_data(expected_data.size());
+        dataset.read(actual_data.data(), expected_shape);
+        CHECK(actual_data == expected_data);
+    }
+
+    SECTION("rejects mismatching buffer")
+    {
+        auto stream = dataset.stream_writer({2});
+
+        matrix const wrong = {3, {1, 2, 3}};
+        CHECK_THROWS_AS(stream.write_n(wrong), h5::exception);
+    }
+}
+
+TEST_CASE("stream_writer - async stream writes all records")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    h5::dataset<int, 2> dataset = file.dataset<int, 2>("data");
+
+    h5::dataset_options options;
+    options.compression = 1;
+
+    h5::stream_options stream_options;
+    stream_options.async = true;
+
+    std::size_t const record_count = 20000;
+    std::vector<int> expected_data;
+    {
+        auto stream = dataset.stream_writer({4}, options, stream_options);
+
+        std::vector<int> record(4);
+        for (std::size_t i = 0; i < record_count; i++) {
+            for (auto& value : record) {
+                value = int(expected_data.size());
+                expected_data.push_back(value);
+            }
+            stream.write(record);
+
+            if (i == record_count / 2) {
+                stream.flush();
+                CHECK(dataset.shape() == h5::shape<2>{i + 1, 4});
+            }
+        }
+
+        std::vector<int> block(4 * 5000);
+        for (auto& value : block) {
+            value = int(expected_data.size());
+            expected_data.push_back(value);
+        }
+        stream.write_n(block.data(), 5000);
+    }
+
+    h5::shape<2> const expected_shape = {expected_data.size() / 4, 4};
+    CHECK(dataset.shape() == expected_shape);
+
+    std::vector<int> actual_data(expected_data.size());
+    dataset.read(actual_data.data(), expected_shape);
+    CHECK(actual_data == expected_data);
+}
+
+TEST_CASE("stream_writer - async stream reports background error")
+{
+    temporary tmp;
+    {
+        h5::file file(tmp.filename, "w");
+        file.dataset<int, 2>("data").stream_writer({4});
+    }
+
+    // Writes fail in the background thread since the file is read-only.
+    h5::file file(tmp.filename, "r");
+    h5::dataset<int, 2> dataset = file.dataset<int, 2>("data");
+
+    h5::stream_options stream_options;
+    stream_options.async = true;
+
+    h5::stream_writer<int, 1> stream{
+        file.handle(), dataset.handle(), {4}, stream_options
+    };
+
+    // The error may be reported as soon as the next hand-off.
+    std::vector<int> block(4 * 10000);
+    auto const write_and_flush = [&] {
+        stream.write_n(block.data(), 10000);
+        stream.flush();
+    };
+    CHECK_THROWS_AS(write_and_flush(), h5::exception);
+}
+
+TEST_CASE("stream_writer - async stream drops records after background error")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+    h5::dataset<int, 2> dataset = file.dataset<int, 2>("data");
+
+    h5::stream_options stream_options;
+    stream_options.async = true;
+
+    {
+        auto stream = dataset.stream_writer({4}, {}, stream_options);
+
+        // The first batch fails in the background thread.
+        unconvertible_value const bad_record[4] = {};
+        stream.write(bad_record);
+        CHECK_THROWS_AS(stream.flush(), h5::exception);
+
+        // Records written after the failure must not reach the dataset.
+        std::vector<int> const record = {1, 2, 3, 4};
+        stream.write(record);
+        CHECK_THROWS_AS(stream.flush(), h5::exception);
+        stream.write(record);
+        CHECK_THROWS_AS(stream.flush(), h5::exception);
+    }
+
+    CHECK(dataset.shape() == h5::shape<2>{0, 4});
+}
+
+TEST_CASE("stream_writer - direct chunk stream writes all records")
+{
+    temporary tmp;
+    h5::file file(tmp.filename, "w");
+
+    h5::dataset_options options;
+    options.compression = 1;
+
+    h5::stream_options stream_options;
+    stream_options.direct_chunk = true;
+
+    SECTION("small records")
+    {
+        h5::dataset<int, 2> dataset = file.dataset<int, 2>("data");
+
+        std::vector<int> expected_data;
+        {
+            auto stream = dataset.stream_writer({4}, options, stream_options);
+
+            std::vector<int> record(4);
+            for (std::size_t i = 0; i < 5000; i++) {
+                for (auto& value : record) {
+                    value = int(expected_data.size());
+                    expected_data.push_back(value);
+                }
+                stream.write(record);
+
+                // Flushing leaves a partially written chunk.
+                if (i == 1234) {
+                    stream.flush();
+                }
+            }
+
+            std::vector<double> block(4 * 5000);
+            for (auto& value : block) {
+                value = double(expected_data.size());
+                expected_data.push_back(int(value));
+            }
+            stream.write_n(block.data(), 5000);
+        }
+
+        h5::shape<2> const expected_shape = {expected_data.size() / 4, 4};
+        CHECK(dataset.shape() == expected_shape);
+
+        std::vector<int> actual_data(expected_data.size());
+        dataset.read(actual_data.data(), expected_shape);
+        CHECK(actual_data == expected_data);
+    }
+
+    SECTION("large records with partial edge chunks")
+    {
+        h5::dataset<float, 3> dataset = file.dataset<float, 3>("data");
+        h5::shape<2> const record_shape = {3001, 7};
+
+        std::vector<float> expected_data;
+        {
+            stream_options.async = true;
+            auto stream = dataset.stream_writer(record_shape, options, stream_options);
+
+            std::vector<float> record(record_shape.size());
+            for (std::size_t i = 0; i < 10; i++) {
+                for (auto& value : record) {
+                    value = float(expected_data.size() % 1000);
+                    expected_data.push_back(value);
+                }
+                stream.write(record.data());
+            }
+        }
+
+        h5::shape<3> const expected_shape = {10, 3001, 7};
+        CHECK(dataset.shape() == expected_shape);
+
+        std::vector<float> actual_data(expected_data.size());
+        dataset.read(actual_data.data(), expected_shape);
+        CHECK(actual_data == expected_data);
+    }
+
+    SECTION("unsupported filter")
+    {
+        h5::dataset<int, 2> dataset = file.dataset<int, 2>("data");
+        options.scaleoffset = 0;
+
+        std::vector<int> expected_data;
+        {
+            auto stream = dataset.stream_writer({4}, options, stream_options);
+
+            std::vector<int> record(4);
+            for (std::size_t i = 0; i < 3000; i++) {
+                for (auto& value : record) {
+                    value = int(expected_data.size());
+                    expected_data.push_back(value);
+                }
+                stream.write(record);
+            }
+        }
+
+        h5::shape<2> const expected_shape = {expected_data.size() / 4, 4};
+        std::vector<int> actual_data(expected_data.size());
+        dataset.read(actual_data.data(), expected_shape);
+        CHECK(actual_data == expected_data);
+    }
+}
+
+TEST_CASE("dataset::stream_writer - resumes appending to existing dataset")
+{
+    temporary tmp;
+
+    h5::stream_options stream_options;
+    stream_options.append = true;
+
+    SECTION("appends after existing records")
+    {
+        h5::dataset_options options;
+        options.compression = 1;
+
+        for (int run = 0; run < 3; run++) {
+            h5::file file(tmp.filename, run == 0 ? "w" : "r+");
+            auto dataset = file.dataset<int, 2>("data");
+            auto stream = dataset.stream_writer({2}, options, stream_options);
+
+            std::vector<int> const record = {run, -run};
+            stream.write(record);
+            stream.write(record);
+        }
+
+        h5::file file(tmp.filename, "r");
+        auto dataset = file.dataset<int, 2>("data");
+        REQUIRE(dataset.shape() == h5::shape<2>{6, 2});
+
+        std::vector<int> const expected_data = {
+            0, 0, 0, 0, 1, -1, 1, -1, 2, -2, 2, -2
+        };
+        std::vector<int> actual_data(expected_data.size());
+        dataset.read(actual_data.data(), {6, 2});
+        CHECK(actual_data == expected_data);
+    }
+
+    SECTION("resumes after records written out by a killed stream")
+    {
+        {
+            h5::file file(tmp.filename, "w");
+            auto dataset = file.dataset<int, 2>("data");
+            dataset.stream_writer({2});
+
+            // The sink of a buffered stream grows the extent ahead of the
+            // records and is not trimmed here, as if the process was killed.
+            hsize_t const record_dims[] = {2};
+            h5::detail::stream_sink<2> sink{dataset.handle(), record_dims, 100};
+
+            std::vector<int> const records = {1, -1, 2, -2, 3, -3};
+            sink.append(H5T_NATIVE_INT, records.data(), 3);
+            sink.trim();
+            CHECK(H5Aexists(dataset.handle(), ".stream_size") == 0);
+
+            // Records written after the last trim are lost.
+            std::vector<int> const lost_record = {9, -9};
+            sink.append(H5T_NATIVE_INT, lost_record.data(), 1);
+            CHECK(H5Aexists(dataset.handle(), ".stream_size") > 0);
+        }
+
+        {
+            h5::file file(tmp.filename, "r+");
+            auto dataset = file.dataset<int, 2>("data");
+            REQUIRE(dataset.shape() == h5::shape<2>{100, 2});
+
+            auto stream = dataset.stream_writer({2}, {}, stream_options);
+            std::vector<int> const record = {4, -4};
+            stream.write(record);
+        }
+
+        h5::file file(tmp.filename, "r");
+        auto dataset = file.dataset<int, 2>("data");
+        REQUIRE(dataset.shape() == h5::shape<2>{4, 2});
+        CHECK(H5Aexists(dataset.handle(), ".stream_size") == 0);
+
+        std::vector<int> const expected_data = {1, -1, 2, -2, 3, -3, 4, -4};
+        std::vector<int> actual_data(expected_data.size());
+        dataset.read(actual_data.data(), {4, 2});
+        CHECK(actual_data == expected_data);
+    }
+
+    SECTION("rejects mismatching record shape")
+    {
+        h5::file file(tmp.filename, "w");
+        auto dataset = file.dataset<int, 2>("data");
+        dataset.stream_writer({2});
+
+        CHECK_THROWS_AS(dataset.stream_writer({3}, {}, stream_options), h5::exception);
+    }
+
+    SECTION("rejects fixed-size dataset")
+    {
+        h5::file file(tmp.filename, "w");
+        auto dataset = file.dataset<int, 2>("data");
+        std::vector<int> const data = {1, 2, 3, 4};
+        dataset.write(data.data(), {2, 2});
+
+        CHECK_THROWS_AS(dataset.stream_writer({2}, {}, stream_options), h5::exception);
+    }
+}